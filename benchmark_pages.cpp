@@ -0,0 +1,101 @@
+#include "hybrid_store.hpp"
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <random>
+
+using namespace std;
+using namespace std::chrono;
+
+// Store scans with each page size request. The store is sized well past the
+// TLB reach of 4 KiB pages. A full scan is mostly bandwidth bound, while a
+// selective filtered scan jumps between pages and is dominated by TLB misses,
+// so that is where huge pages should show the larger difference.
+
+const char* page_size_name(PageSize pages) {
+    switch (pages) {
+        case PageSize::base:
+            return "base 4K";
+        case PageSize::transparent:
+            return "transparent";
+        case PageSize::huge_2m:
+            return "hugetlb 2M";
+        case PageSize::huge_1g:
+            return "hugetlb 1G";
+    }
+    return "?";
+}
+
+// Best of several repetitions, in milliseconds
+template<typename Fn>
+double time_ms(Fn&& fn) {
+    const int repetitions = 5;
+    double best = numeric_limits<double>::max();
+    for (int rep = 0; rep < repetitions; rep++) {
+        auto start = high_resolution_clock::now();
+        fn();
+        auto end = high_resolution_clock::now();
+        best = min(best, duration_cast<microseconds>(end - start).count() / 1000.0);
+    }
+    return best;
+}
+
+int main() {
+    const size_t vector_size = 512;
+    const size_t num_vectors = 200000;
+    const size_t k = 10;
+
+    mt19937 gen(42);
+    uniform_real_distribution<double> dis(-10.0, 10.0);
+
+    vector<double> row(vector_size);
+    vector<HybridVector<double, uint8_t>> queries;
+    for (int i = 0; i < 4; i++) {
+        for (double& x : row) {
+            x = dis(gen);
+        }
+        queries.emplace_back(row);
+    }
+
+    // Selective filter: 1% of rows, spread randomly
+    IdBitset selective(num_vectors);
+    uniform_int_distribution<size_t> pick(0, num_vectors - 1);
+    for (size_t i = 0; i < num_vectors / 100; i++) {
+        selective.set(pick(gen));
+    }
+
+    cout << "Huge page benchmark (" << num_vectors << " vectors of " << vector_size << ")" << endl;
+
+    double base_full = 0, base_selective = 0;
+    for (PageSize requested : {PageSize::base, PageSize::transparent, PageSize::huge_2m, PageSize::huge_1g}) {
+        HybridStore<double, uint8_t> store(vector_size / 2, 16384, -1, 0, 1, requested);
+        for (size_t i = 0; i < num_vectors; i++) {
+            for (double& x : row) {
+                x = dis(gen);
+            }
+            store.insert(HybridVector<double, uint8_t>(row));
+        }
+
+        double full = time_ms([&] {
+            for (const auto& query : queries) {
+                store.search(query, k);
+            }
+        });
+        double filtered = time_ms([&] {
+            for (const auto& query : queries) {
+                store.search(query, k, IdFilter(selective));
+            }
+        });
+        if (requested == PageSize::base) {
+            base_full = full;
+            base_selective = filtered;
+        }
+
+        cout << "requested " << page_size_name(requested)
+             << ", got " << page_size_name(store.page_size()) << ":" << endl;
+        cout << "  full scan:      " << full << " ms (" << base_full / full << "x vs base)" << endl;
+        cout << "  1% filter scan: " << filtered << " ms (" << base_selective / filtered << "x vs base)" << endl;
+    }
+
+    return 0;
+}
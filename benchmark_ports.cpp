@@ -0,0 +1,190 @@
+#include "hybrid_vector.hpp"
+#include "hybrid_perf.hpp"
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <random>
+#include <iomanip>
+
+using namespace std;
+using namespace std::chrono;
+
+// Microbenchmark for the interleaved fp/q kernel. Each kernel runs over
+// L1-resident data so timings reflect execution ports, not memory. If float
+// and integer work really overlap, the interleaved kernel costs close to
+// max(fp only, q only) rather than their sum. Where hardware counters are
+// readable it also prints cycles, IPC and ALU-port uops per call, which
+// show whether the halves really overlap or merely share ports 0/1/5.
+
+const size_t lanes = hybrid_kernel_lanes;
+
+// Float half only, same accumulator structure as the hybrid kernel
+template<typename fpT>
+fpT fp_only(const fpT* a, const fpT* b, size_t n) {
+    fpT acc[lanes] = {};
+    for (size_t i = 0; i < n; i += lanes) {
+#pragma omp simd
+        for (size_t j = 0; j < lanes; j++) {
+            fpT diff = a[i + j] - b[i + j];
+            acc[j] += diff * diff;
+        }
+    }
+    fpT sum = 0;
+    for (size_t j = 0; j < lanes; j++) {
+        sum += acc[j];
+    }
+    return sum;
+}
+
+// Quantized half only, int32 accumulation
+int64_t q_only(const uint8_t* a, const uint8_t* b, size_t n) {
+    int32_t acc[lanes] = {};
+    for (size_t i = 0; i < n; i += lanes) {
+#pragma omp simd
+        for (size_t j = 0; j < lanes; j++) {
+            int16_t diff = static_cast<int16_t>(a[i + j]) - static_cast<int16_t>(b[i + j]);
+            acc[j] += static_cast<int32_t>(diff) * diff;
+        }
+    }
+    int64_t sum = 0;
+    for (size_t j = 0; j < lanes; j++) {
+        sum += acc[j];
+    }
+    return sum;
+}
+
+// Previous kernel: both halves folded into one floating-point reduction chain
+template<typename fpT>
+fpT fused_single_chain(const fpT* a_fp, const uint8_t* a_q, const fpT* b_fp, const uint8_t* b_q,
+                       size_t n, fpT scale_squared) {
+    fpT sum = 0;
+#pragma omp simd reduction(+:sum)
+    for (size_t i = 0; i < n; i++) {
+        fpT fp_diff = a_fp[i] - b_fp[i];
+        sum += fp_diff * fp_diff;
+        fpT q_diff = static_cast<fpT>(a_q[i]) - static_cast<fpT>(b_q[i]);
+        sum += q_diff * q_diff * scale_squared;
+    }
+    return sum;
+}
+
+// Best of several repetitions, to filter out interference from other work
+template<typename Fn>
+double time_ns_per_call(Fn&& fn, int iterations) {
+    const int repetitions = 7;
+    volatile double sink = 0;
+    for (int i = 0; i < iterations / 10; i++) {
+        sink = sink + fn();
+    }
+
+    double best = numeric_limits<double>::max();
+    for (int rep = 0; rep < repetitions; rep++) {
+        auto start = high_resolution_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            sink = sink + fn();
+        }
+        auto end = high_resolution_clock::now();
+        best = min(best, duration_cast<nanoseconds>(end - start).count() / static_cast<double>(iterations));
+    }
+    return best;
+}
+
+// Per-call counts of every counted event over iterations calls
+template<typename Fn>
+vector<double> counts_per_call(PerfCounters& perf, Fn&& fn, int iterations) {
+    volatile double sink = 0;
+    perf.start();
+    for (int i = 0; i < iterations; i++) {
+        sink = sink + fn();
+    }
+    perf.stop();
+    vector<double> counts = perf.read();
+    for (double& count : counts) {
+        count /= iterations;
+    }
+    return counts;
+}
+
+int main() {
+    const size_t half_size = 1024;
+    const int iterations = 50000;
+    const double scale_squared = 1e-3;
+
+    mt19937 gen(42);
+    uniform_real_distribution<double> dis(-10.0, 10.0);
+    uniform_int_distribution<int> qdis(0, 255);
+
+    vector<double> a_fp(half_size), b_fp(half_size);
+    vector<uint8_t> a_q(half_size), b_q(half_size);
+    for (size_t i = 0; i < half_size; i++) {
+        a_fp[i] = dis(gen);
+        b_fp[i] = dis(gen);
+        a_q[i] = qdis(gen);
+        b_q[i] = qdis(gen);
+    }
+
+    double t_fp = time_ns_per_call([&] {
+        return fp_only(a_fp.data(), b_fp.data(), half_size);
+    }, iterations);
+    double t_q = time_ns_per_call([&] {
+        return static_cast<double>(q_only(a_q.data(), b_q.data(), half_size));
+    }, iterations);
+    double t_interleaved = time_ns_per_call([&] {
+        return hybrid_squared_distance(a_fp.data(), a_q.data(), b_fp.data(), b_q.data(), half_size, scale_squared);
+    }, iterations);
+    double t_fused = time_ns_per_call([&] {
+        return fused_single_chain(a_fp.data(), a_q.data(), b_fp.data(), b_q.data(), half_size, scale_squared);
+    }, iterations);
+
+    cout << "Execution port microbenchmark (half size " << half_size << ", L1 resident)" << endl;
+    cout << "fp half only:       " << t_fp << " ns" << endl;
+    cout << "q half only:        " << t_q << " ns" << endl;
+    cout << "fp + q sequential:  " << t_fp + t_q << " ns" << endl;
+    cout << "interleaved kernel: " << t_interleaved << " ns" << endl;
+    cout << "single-chain fused: " << t_fused << " ns" << endl;
+    cout << "Overlap (interleaved / (fp + q)): " << t_interleaved / (t_fp + t_q) << endl;
+    cout << "Speedup vs single chain: " << t_fused / t_interleaved << "x" << endl;
+
+    vector<PerfEvent> events = perf_default_events();
+    for (const PerfEvent& event : perf_port_events()) {
+        events.push_back(event);
+    }
+    PerfCounters perf(events);
+    if (perf.empty()) {
+        cout << "Hardware counters unavailable (no PMU, or kernel.perf_event_paranoid too high)" << endl;
+        return 0;
+    }
+
+    cout << endl << "Counters per call:" << endl;
+    cout << "kernel            ";
+    for (const PerfEvent& event : perf.events()) {
+        cout << " " << setw(12) << event.name;
+    }
+    cout << " " << setw(12) << "IPC" << endl;
+    auto print_counts = [&](const char* name, const vector<double>& counts) {
+        cout << left << setw(18) << name << right;
+        for (double count : counts) {
+            cout << " " << setw(12) << fixed << setprecision(1) << count;
+        }
+        const size_t cycles = perf.find("cycles");
+        const size_t instructions = perf.find("instructions");
+        if (cycles < perf.size() && instructions < perf.size() && counts[cycles] > 0) {
+            cout << " " << setw(12) << setprecision(2) << counts[instructions] / counts[cycles];
+        }
+        cout << endl;
+    };
+    print_counts("fp half only", counts_per_call(perf, [&] {
+        return fp_only(a_fp.data(), b_fp.data(), half_size);
+    }, iterations));
+    print_counts("q half only", counts_per_call(perf, [&] {
+        return static_cast<double>(q_only(a_q.data(), b_q.data(), half_size));
+    }, iterations));
+    print_counts("interleaved", counts_per_call(perf, [&] {
+        return hybrid_squared_distance(a_fp.data(), a_q.data(), b_fp.data(), b_q.data(), half_size, scale_squared);
+    }, iterations));
+    print_counts("single-chain fused", counts_per_call(perf, [&] {
+        return fused_single_chain(a_fp.data(), a_q.data(), b_fp.data(), b_q.data(), half_size, scale_squared);
+    }, iterations));
+
+    return 0;
+}
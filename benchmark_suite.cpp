@@ -0,0 +1,572 @@
+#include "hybrid_vector.hpp"
+#include "hybrid_perf.hpp"
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Google Benchmark suite for the distance kernel. Benchmarks are
+// parametrised over dimension, fp and q element types, the share of each
+// vector kept in full precision (fp_pct: 0 is all quantized, 100 all fp),
+// instruction set and access pattern. One iteration computes one pair
+// distance; counters report time per pair, pairs/s and operand bytes/s,
+// and every benchmark is warmed up and repeated with mean/median/stddev/
+// cv/min aggregates. Command-line flags override the defaults in main().
+//
+// Families (select with --benchmark_filter):
+//   kernel/<fp>/<q>/<isa>     instruction sets on L1-resident pairs
+//   split/<fp>/<q>            fp_pct from 0 to 100, sequential rows
+//   access/<fp>/<q>/<access>  cached, sequential, random and scan rows
+//   stream_triad              STREAM triad bandwidth by working-set size
+//   roofline/<fp>/<q>/<repr>  fp, hybrid and q rows scanned by dataset size
+//
+// The instruction-set variants recompile the kernel under a target
+// attribute, which only takes effect when the build itself targets an
+// older baseline: build without -march=native to get them. Otherwise only
+// the "default" kernel (whatever the build flags select) is registered.
+//
+// --perf adds hardware counters per pair around the measured loop: cycles,
+// instructions, IPC, L1D/LLC/dTLB misses, and uops on ALU ports 0, 1, 5
+// and 6 on Intel cores with known encodings. --perf_events=name:rXXXX,...
+// adds raw events. Events the kernel refuses are left out.
+//
+// The roofline family scans datasets from 16 KB up to --roofline_max_mb
+// (default 8x the last-level cache) and divides the bytes/s it achieves by
+// a single-threaded STREAM triad measured at the same working-set size, so
+// roof=1 means the kernel runs at the bandwidth that level of the memory
+// hierarchy can sustain and more arithmetic speed would not help.
+
+const size_t lanes = hybrid_kernel_lanes;
+
+// Row pool size for the sequential and random patterns; --pool_mb=N
+size_t pool_bytes = size_t(64) << 20;
+
+// Largest roofline dataset; --roofline_max_mb=N
+size_t roofline_max_bytes = 0;
+
+// Counters read around each measured loop; null without --perf
+unique_ptr<PerfCounters> perf;
+
+enum class Isa { Default, Sse42, Avx2, Avx512, Avx512Fp16 };
+// Scan compares row 0 against every row, as a query against a collection
+enum class Access { Cached, Sequential, Random, Scan };
+
+const char* isa_name(Isa isa) {
+    switch (isa) {
+        case Isa::Sse42: return "sse4.2";
+        case Isa::Avx2: return "avx2";
+        case Isa::Avx512: return "avx512";
+        case Isa::Avx512Fp16: return "avx512fp16";
+        default: return "default";
+    }
+}
+
+const char* access_name(Access access) {
+    switch (access) {
+        case Access::Sequential: return "sequential";
+        case Access::Random: return "random";
+        case Access::Scan: return "scan";
+        default: return "cached";
+    }
+}
+
+bool isa_supported(Isa isa) {
+    switch (isa) {
+        case Isa::Sse42: return __builtin_cpu_supports("sse4.2");
+        case Isa::Avx2: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case Isa::Avx512:
+            return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+                   __builtin_cpu_supports("avx512vl");
+        case Isa::Avx512Fp16: return __builtin_cpu_supports("avx512fp16");
+        default: return true;
+    }
+}
+
+template <typename T> const char* type_name();
+template <> const char* type_name<float>() { return "float"; }
+template <> const char* type_name<double>() { return "double"; }
+template <> const char* type_name<uint8_t>() { return "u8"; }
+template <> const char* type_name<uint16_t>() { return "u16"; }
+#ifdef __FLT16_MAX__
+using fp16 = _Float16;
+template <> const char* type_name<fp16>() { return "fp16"; }
+#endif
+
+// Rows of fp_n full-precision values and q_n codes, each half contiguous
+// across rows as in a store segment, plus the order pairs are visited in:
+// pair k is (order[2k], order[2k + 1]). A scan keeps its query row in
+// cache, so only the other row of each pair counts as bytes moved.
+template <typename fpT, typename qT>
+struct Rows {
+    size_t dim = 0, fp_pct = 0, bytes = 0;
+    Access access = Access::Cached;
+    size_t fp_n = 0, q_n = 0, count = 0;
+    vector<fpT> fp;
+    vector<qT> q;
+    vector<fpT> scale;
+    vector<uint32_t> order;
+
+    size_t row_bytes() const { return fp_n * sizeof(fpT) + q_n * sizeof(qT) + sizeof(fpT); }
+    size_t bytes_per_pair() const { return (access == Access::Scan ? 1 : 2) * row_bytes(); }
+};
+
+// The pool for the last parameters asked for. Google Benchmark calls a
+// benchmark once per repetition, so this keeps setup out of every run after
+// the first without holding pools for benchmarks that already finished.
+template <typename fpT, typename qT>
+const Rows<fpT, qT>& pool_rows(size_t dim, size_t fp_pct, Access access, size_t bytes = pool_bytes) {
+    static unique_ptr<Rows<fpT, qT>> rows;
+    if (rows && rows->dim == dim && rows->fp_pct == fp_pct && rows->access == access && rows->bytes == bytes) {
+        return *rows;
+    }
+    rows.reset();
+    rows = make_unique<Rows<fpT, qT>>();
+    rows->dim = dim;
+    rows->fp_pct = fp_pct;
+    rows->access = access;
+    rows->bytes = bytes;
+    rows->fp_n = dim * fp_pct / 100;
+    rows->q_n = dim - rows->fp_n;
+    rows->count = (access == Access::Cached) ? 2 : max<size_t>(2, (bytes / rows->row_bytes()) & ~size_t(1));
+
+    // One 64-bit draw per element; pools can run to hundreds of MB
+    mt19937_64 gen(42);
+    rows->fp.resize(rows->count * rows->fp_n);
+    rows->q.resize(rows->count * rows->q_n);
+    rows->scale.resize(rows->count);
+    for (auto& value : rows->fp) {
+        value = static_cast<fpT>(static_cast<double>(gen() >> 11) * 0x1p-53 * 20.0 - 10.0);
+    }
+    for (auto& code : rows->q) {
+        code = static_cast<qT>(gen());
+    }
+    for (auto& scale : rows->scale) {
+        scale = static_cast<fpT>(20.0 / numeric_limits<qT>::max());
+    }
+
+    if (access == Access::Scan) {
+        for (size_t i = 1; i < rows->count; i++) {
+            rows->order.insert(rows->order.end(), {0, static_cast<uint32_t>(i)});
+        }
+    } else {
+        rows->order.resize(rows->count);
+        for (size_t i = 0; i < rows->count; i++) {
+            rows->order[i] = static_cast<uint32_t>(i);
+        }
+    }
+    if (access == Access::Random) {
+        shuffle(rows->order.begin(), rows->order.end(), gen);
+    }
+    return *rows;
+}
+
+// Float-only tail, same accumulator structure as the hybrid kernel
+template <typename fpT>
+fpT fp_squared_distance(const fpT* a, const fpT* b, size_t n) {
+    fpT acc[lanes] = {};
+    size_t i = 0;
+    for (; i + lanes <= n; i += lanes) {
+#pragma omp simd
+        for (size_t j = 0; j < lanes; j++) {
+            fpT diff = a[i + j] - b[i + j];
+            acc[j] += diff * diff;
+        }
+    }
+    fpT sum = 0;
+    for (size_t j = 0; j < lanes; j++) {
+        sum += acc[j];
+    }
+    for (; i < n; i++) {
+        fpT diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// Quantized-only tail. Vectors here are short enough that 8-bit codes
+// never need the kernel's periodic int32 flush.
+template <typename qT>
+int64_t q_squared_distance(const qT* a, const qT* b, size_t n) {
+    using diff_t = typename HybridCodeAccumulator<qT>::diff_t;
+    using acc_t = typename HybridCodeAccumulator<qT>::acc_t;
+    assert(n <= lanes * HybridCodeAccumulator<qT>::flush_steps);
+
+    acc_t acc[lanes] = {};
+    size_t i = 0;
+    for (; i + lanes <= n; i += lanes) {
+#pragma omp simd
+        for (size_t j = 0; j < lanes; j++) {
+            diff_t diff = static_cast<diff_t>(a[i + j]) - static_cast<diff_t>(b[i + j]);
+            acc[j] += static_cast<acc_t>(diff) * diff;
+        }
+    }
+    int64_t sum = 0;
+    for (size_t j = 0; j < lanes; j++) {
+        sum += acc[j];
+    }
+    for (; i < n; i++) {
+        int64_t diff = static_cast<int64_t>(a[i]) - static_cast<int64_t>(b[i]);
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// Interleaved kernel over the elements both halves cover, then whichever
+// half is longer on its own. fp_pct 50 is exactly hybrid_squared_distance.
+template <typename fpT, typename qT>
+inline fpT split_distance(const Rows<fpT, qT>& rows, size_t a, size_t b) {
+    const size_t common = min(rows.fp_n, rows.q_n);
+    const fpT* a_fp = rows.fp.data() + a * rows.fp_n;
+    const fpT* b_fp = rows.fp.data() + b * rows.fp_n;
+    const qT* a_q = rows.q.data() + a * rows.q_n;
+    const qT* b_q = rows.q.data() + b * rows.q_n;
+    const fpT scale_squared = rows.scale[a] * rows.scale[b];
+
+    fpT distance = hybrid_squared_distance(a_fp, a_q, b_fp, b_q, common, scale_squared);
+    distance += fp_squared_distance(a_fp + common, b_fp + common, rows.fp_n - common);
+    distance += static_cast<fpT>(q_squared_distance(a_q + common, b_q + common, rows.q_n - common)) * scale_squared;
+    return distance;
+}
+
+// flatten inlines the whole kernel so it is vectorised for the target
+#define HYBRID_ISA_KERNEL(name, attributes)                                          \
+    template <typename fpT, typename qT>                                             \
+    attributes fpT name(const Rows<fpT, qT>& rows, size_t a, size_t b) {             \
+        return split_distance(rows, a, b);                                           \
+    }
+
+HYBRID_ISA_KERNEL(distance_default, __attribute__((flatten)))
+HYBRID_ISA_KERNEL(distance_sse42, __attribute__((target("sse4.2"), flatten)))
+HYBRID_ISA_KERNEL(distance_avx2, __attribute__((target("avx2,fma"), flatten)))
+HYBRID_ISA_KERNEL(distance_avx512, __attribute__((target("avx512f,avx512bw,avx512vl,avx512dq,fma"), flatten)))
+HYBRID_ISA_KERNEL(distance_avx512fp16, __attribute__((target("avx512f,avx512bw,avx512vl,avx512dq,avx512fp16,fma"), flatten)))
+
+template <typename fpT, typename qT>
+using Kernel = fpT (*)(const Rows<fpT, qT>&, size_t, size_t);
+
+template <typename fpT, typename qT>
+Kernel<fpT, qT> isa_kernel(Isa isa) {
+    switch (isa) {
+        case Isa::Sse42: return distance_sse42<fpT, qT>;
+        case Isa::Avx2: return distance_avx2<fpT, qT>;
+        case Isa::Avx512: return distance_avx512<fpT, qT>;
+        case Isa::Avx512Fp16: return distance_avx512fp16<fpT, qT>;
+        default: return distance_default<fpT, qT>;
+    }
+}
+
+// Instruction sets worth registering for fpT: explicit targets only on a
+// baseline build, avx512fp16 only for fp16 arithmetic
+template <typename fpT>
+vector<Isa> isa_list() {
+    vector<Isa> list = {Isa::Default};
+#ifndef __AVX__
+    list.insert(list.end(), {Isa::Sse42, Isa::Avx2, Isa::Avx512});
+#ifdef __FLT16_MAX__
+    if (is_same<fpT, fp16>::value) {
+        list.push_back(Isa::Avx512Fp16);
+    }
+#endif
+#endif
+    return list;
+}
+
+// Widest registered instruction set this CPU runs
+template <typename fpT>
+Isa best_isa() {
+    Isa best = Isa::Default;
+    for (Isa isa : isa_list<fpT>()) {
+        if (isa_supported(isa)) {
+            best = isa;
+        }
+    }
+    return best;
+}
+
+// Each counted event per pair, plus IPC when cycles and instructions are
+// both counted
+void add_perf_counters(benchmark::State& state, double pairs) {
+    const vector<double> counts = perf->read();
+    for (size_t i = 0; i < perf->size(); i++) {
+        state.counters[perf->events()[i].name + "/pair"] = counts[i] / pairs;
+    }
+    const size_t cycles = perf->find("cycles");
+    const size_t instructions = perf->find("instructions");
+    if (cycles < perf->size() && instructions < perf->size() && counts[cycles] > 0) {
+        state.counters["IPC"] = counts[instructions] / counts[cycles];
+    }
+}
+
+// The measured loop shared by the distance benchmarks: one pair per
+// iteration in rows.order, with the standard and perf counters
+template <typename fpT, typename qT>
+void measure_pairs(benchmark::State& state, const Rows<fpT, qT>& rows, Kernel<fpT, qT> kernel) {
+    const uint32_t* order = rows.order.data();
+    const size_t order_size = rows.order.size();
+
+    if (perf) {
+        perf->start();
+    }
+    size_t k = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(kernel(rows, order[k], order[k + 1]));
+        k += 2;
+        if (k == order_size) {
+            k = 0;
+        }
+    }
+
+    if (perf) {
+        perf->stop();
+    }
+
+    const double pairs = static_cast<double>(state.iterations());
+    // Rates print with a /s suffix and the inverted rate in seconds, so
+    // pair_time=1.2us, pairs=830k/s, bytes=14G/s
+    state.counters["pair_time"] = benchmark::Counter(pairs, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    state.counters["pairs"] = benchmark::Counter(pairs, benchmark::Counter::kIsRate);
+    state.counters["bytes"] = benchmark::Counter(pairs * rows.bytes_per_pair(), benchmark::Counter::kIsRate,
+                                                 benchmark::Counter::kIs1000);
+    state.counters["pool_MB"] = static_cast<double>(rows.count * rows.row_bytes()) / (1 << 20);
+    if (perf) {
+        add_perf_counters(state, pairs);
+    }
+}
+
+template <typename fpT, typename qT>
+void BM_distance(benchmark::State& state, Isa isa, Access access) {
+    if (!isa_supported(isa)) {
+        state.SkipWithError("instruction set not supported by this CPU");
+        return;
+    }
+    const Rows<fpT, qT>& rows = pool_rows<fpT, qT>(state.range(0), state.range(1), access);
+    measure_pairs(state, rows, isa_kernel<fpT, qT>(isa));
+}
+
+// STREAM triad a = b + s * c over three double arrays filling bytes; one
+// thread, like the distance benchmarks. Counts 24 bytes per element as
+// STREAM does, ignoring write-allocate traffic. The arrays share one
+// buffer with a gap of 64 doubles plus padding to a cache line, so
+// same-index elements are not 4 KiB apart (which halves small-size
+// bandwidth through false store-to-load dependencies).
+struct Triad {
+    size_t n, stride;
+    vector<double> data;
+
+    explicit Triad(size_t bytes)
+        : n(max<size_t>(bytes / (3 * sizeof(double)), 64)),
+          stride(n + 64 + (8 - n % 8) % 8),
+          data(3 * stride, 1.0) {}
+
+    size_t bytes() const { return 3 * sizeof(double) * n; }
+
+    void run(double s) {
+        double* __restrict pa = data.data();
+        const double* __restrict pb = pa + stride;
+        const double* __restrict pc = pb + stride;
+#pragma omp simd
+        for (size_t i = 0; i < n; i++) {
+            pa[i] = pb[i] + s * pc[i];
+        }
+        benchmark::ClobberMemory();
+    }
+};
+
+// Best triad bandwidth in bytes/s over a few trials of at least 64 MB of
+// traffic each, measured once per size
+double triad_bandwidth(size_t bytes) {
+    static map<size_t, double> measured;
+    auto found = measured.find(bytes);
+    if (found != measured.end()) {
+        return found->second;
+    }
+
+    Triad triad(bytes);
+    const size_t runs = max<size_t>(1, (size_t(64) << 20) / triad.bytes());
+    triad.run(3.0);
+    double best = 0;
+    for (int trial = 0; trial < 5; trial++) {
+        auto start = chrono::steady_clock::now();
+        for (size_t r = 0; r < runs; r++) {
+            triad.run(3.0);
+        }
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        best = max(best, static_cast<double>(runs * triad.bytes()) / elapsed.count());
+    }
+    measured[bytes] = best;
+    return best;
+}
+
+void BM_stream_triad(benchmark::State& state) {
+    Triad triad(static_cast<size_t>(state.range(0)) << 10);
+    for (auto _ : state) {
+        triad.run(3.0);
+    }
+    state.counters["bytes"] = benchmark::Counter(static_cast<double>(state.iterations()) * triad.bytes(),
+                                                 benchmark::Counter::kIsRate, benchmark::Counter::kIs1000);
+}
+
+// Scans a dataset of range(0) KB of rows of range(1) elements with the
+// widest kernel. bytes/pair is what one distance streams from the
+// dataset; flops/byte counts a subtract and a multiply-add per element,
+// integer ones on the q half included.
+template <typename fpT, typename qT>
+void BM_roofline(benchmark::State& state, size_t fp_pct) {
+    const size_t bytes = static_cast<size_t>(state.range(0)) << 10;
+    const size_t dim = static_cast<size_t>(state.range(1));
+    const double triad = triad_bandwidth(bytes);
+    const Rows<fpT, qT>& rows = pool_rows<fpT, qT>(dim, fp_pct, Access::Scan, bytes);
+
+    // Own clock for the fraction: a rate counter would print it per second
+    auto start = chrono::steady_clock::now();
+    measure_pairs(state, rows, isa_kernel<fpT, qT>(best_isa<fpT>()));
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    const double pairs = static_cast<double>(state.iterations());
+    state.counters["bytes/pair"] = static_cast<double>(rows.bytes_per_pair());
+    state.counters["flops/byte"] = 3.0 * dim / rows.bytes_per_pair();
+    state.counters["triad"] = benchmark::Counter(triad, benchmark::Counter::kDefaults, benchmark::Counter::kIs1000);
+    state.counters["roof"] = pairs * rows.bytes_per_pair() / elapsed.count() / triad;
+}
+
+// Working-set sizes in KB, doubling from 16 KB (in L1) to roofline_max_bytes
+vector<int64_t> roofline_sizes_kb() {
+    vector<int64_t> sizes;
+    for (size_t bytes = size_t(16) << 10; bytes <= roofline_max_bytes; bytes *= 2) {
+        sizes.push_back(static_cast<int64_t>(bytes >> 10));
+    }
+    return sizes;
+}
+
+// Best repetition, as the hand-rolled benchmarks report
+double statistic_min(const vector<double>& values) {
+    return *min_element(values.begin(), values.end());
+}
+
+template <typename fpT, typename qT>
+benchmark::internal::Benchmark* register_distance(const string& name, Isa isa, Access access) {
+    return benchmark::RegisterBenchmark(name.c_str(), BM_distance<fpT, qT>, isa, access)
+        ->ArgNames({"dim", "fp_pct"})
+        ->ComputeStatistics("min", statistic_min);
+}
+
+template <typename fpT, typename qT>
+void register_types() {
+    const string types = string(type_name<fpT>()) + "/" + type_name<qT>();
+    const Isa best = best_isa<fpT>();
+
+    for (Isa isa : isa_list<fpT>()) {
+        auto* bench = register_distance<fpT, qT>("kernel/" + types + "/" + isa_name(isa), isa, Access::Cached);
+        for (int64_t dim = 64; dim <= 8192; dim *= 2) {
+            bench->Args({dim, 50});
+        }
+    }
+
+    auto* split = register_distance<fpT, qT>("split/" + types, best, Access::Sequential);
+    for (int64_t dim = 64; dim <= 8192; dim *= 2) {
+        for (int64_t fp_pct : {0, 25, 50, 75, 100}) {
+            split->Args({dim, fp_pct});
+        }
+    }
+
+    for (Access access : {Access::Cached, Access::Sequential, Access::Random, Access::Scan}) {
+        auto* bench = register_distance<fpT, qT>("access/" + types + "/" + access_name(access), best, access);
+        for (int64_t dim = 64; dim <= 8192; dim *= 2) {
+            bench->Args({dim, 50});
+        }
+    }
+}
+
+template <typename fpT, typename qT>
+void register_roofline() {
+    const string types = string(type_name<fpT>()) + "/" + type_name<qT>();
+    const pair<const char*, size_t> representations[] = {{"fp", 100}, {"hybrid", 50}, {"q", 0}};
+    for (const auto& [name, fp_pct] : representations) {
+        auto* bench = benchmark::RegisterBenchmark(("roofline/" + types + "/" + name).c_str(),
+                                                   BM_roofline<fpT, qT>, fp_pct)
+                          ->ArgNames({"kb", "dim"})
+                          ->ComputeStatistics("min", statistic_min);
+        for (int64_t kb : roofline_sizes_kb()) {
+            bench->Args({kb, 1024});
+        }
+    }
+}
+
+template <typename fpT>
+void register_fp_type() {
+    register_types<fpT, uint8_t>();
+    register_types<fpT, uint16_t>();
+}
+
+int main(int argc, char** argv) {
+    // Defaults first so the same flags on the command line override them
+    vector<char*> args = {argv[0]};
+    string defaults[] = {"--benchmark_min_warmup_time=0.05", "--benchmark_min_time=0.1",
+                         "--benchmark_repetitions=5", "--benchmark_report_aggregates_only=true"};
+    for (auto& flag : defaults) {
+        args.push_back(flag.data());
+    }
+    args.insert(args.end(), argv + 1, argv + argc);
+    int args_count = static_cast<int>(args.size());
+    benchmark::Initialize(&args_count, args.data());
+
+    bool use_perf = false;
+    vector<PerfEvent> perf_events = perf_default_events();
+    for (const PerfEvent& event : perf_port_events()) {
+        perf_events.push_back(event);
+    }
+    for (int i = 1; i < args_count; i++) {
+        if (strncmp(args[i], "--pool_mb=", 10) == 0) {
+            pool_bytes = static_cast<size_t>(atoll(args[i] + 10)) << 20;
+        } else if (strncmp(args[i], "--roofline_max_mb=", 18) == 0) {
+            roofline_max_bytes = static_cast<size_t>(atoll(args[i] + 18)) << 20;
+        } else if (strcmp(args[i], "--perf") == 0) {
+            use_perf = true;
+        } else if (strncmp(args[i], "--perf_events=", 14) == 0) {
+            use_perf = true;
+            for (const PerfEvent& event : perf_parse_raw_events(args[i] + 14)) {
+                perf_events.push_back(event);
+            }
+        } else {
+            cerr << "Unknown argument: " << args[i] << endl;
+            return 1;
+        }
+    }
+
+    if (use_perf) {
+        perf = make_unique<PerfCounters>(perf_events);
+        if (perf->empty()) {
+            cerr << "No performance counters available (no PMU, or kernel.perf_event_paranoid too high)" << endl;
+            perf.reset();
+        }
+    }
+
+    if (roofline_max_bytes == 0) {
+        const long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+        roofline_max_bytes = 8 * static_cast<size_t>(llc > 0 ? llc : 32L << 20);
+    }
+
+    register_fp_type<float>();
+    register_fp_type<double>();
+#ifdef __FLT16_MAX__
+    register_fp_type<fp16>();
+#endif
+
+    auto* triad = benchmark::RegisterBenchmark("stream_triad", BM_stream_triad)
+                      ->ArgNames({"kb"})
+                      ->ComputeStatistics("min", statistic_min);
+    for (int64_t kb : roofline_sizes_kb()) {
+        triad->Arg(kb);
+    }
+    register_roofline<float, uint8_t>();
+    register_roofline<double, uint8_t>();
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+// Requires C++20 (-std=c++20) for <coroutine>
+#include "hybrid_scheduler.hpp"
+#include <coroutine>
+
+// Shared cancellation flag. A CancellationSource cancels; any number of
+// CancellationTokens copied from it observe the request.
+class CancellationToken {
+private:
+    std::shared_ptr<const std::atomic<bool>> m_flag;
+
+public:
+    CancellationToken() = default;
+    explicit CancellationToken(std::shared_ptr<const std::atomic<bool>> flag) : m_flag(std::move(flag)) {}
+
+    bool cancelled() const {
+        return m_flag != nullptr && m_flag->load(std::memory_order_relaxed);
+    }
+};
+
+class CancellationSource {
+private:
+    std::shared_ptr<std::atomic<bool>> m_flag = std::make_shared<std::atomic<bool>>(false);
+
+public:
+    CancellationToken token() const { return CancellationToken(m_flag); }
+    void cancel() { m_flag->store(true, std::memory_order_relaxed); }
+    bool cancelled() const { return m_flag->load(std::memory_order_relaxed); }
+};
+
+enum class SearchStatus {
+    ok,
+    cancelled,
+    deadline_exceeded
+};
+
+// Neighbours found before the search finished or was stopped. On cancellation
+// or deadline the neighbours cover only the segments scanned so far.
+template <typename fpT>
+struct SearchResult {
+    SearchStatus status = SearchStatus::ok;
+    std::vector<Neighbor<fpT>> neighbors;
+};
+
+struct AsyncSearchOptions {
+    IdFilter filter;
+    CancellationToken token;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+};
+
+// Awaitable returned by async_search(). Suspending submits the search to the
+// scheduler; the coroutine is resumed on the worker that finishes the last
+// stripe. Cancellation and deadline are checked before every segment.
+template <typename fpT, typename qT>
+class SearchAwaitable {
+private:
+    WorkStealingScheduler& m_scheduler;
+    const HybridStore<fpT, qT>& m_store;
+    const HybridVector<fpT, qT>& m_query;
+    size_t m_k;
+    AsyncSearchOptions m_options;
+    SearchResult<fpT> m_result;
+
+    SearchStatus m_check() const {
+        if (m_options.token.cancelled()) {
+            return SearchStatus::cancelled;
+        }
+        if (std::chrono::steady_clock::now() >= m_options.deadline) {
+            return SearchStatus::deadline_exceeded;
+        }
+        return SearchStatus::ok;
+    }
+
+public:
+    SearchAwaitable(WorkStealingScheduler& scheduler, const HybridStore<fpT, qT>& store,
+                    const HybridVector<fpT, qT>& query, size_t k, AsyncSearchOptions options)
+        : m_scheduler(scheduler), m_store(store), m_query(query), m_k(k), m_options(std::move(options)) {}
+
+    // Already cancelled or expired searches complete without suspending
+    bool await_ready() {
+        m_result.status = m_check();
+        return m_result.status != SearchStatus::ok;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        // Nothing may touch *this after search_then(): the coroutine can be
+        // resumed, and this awaitable destroyed, before it returns
+        m_scheduler.search_then(m_store, m_query, m_k, m_options.filter,
+                                [this] { return m_check() != SearchStatus::ok; },
+                                [this, handle](std::vector<Neighbor<fpT>> neighbors, bool completed) {
+                                    m_result.neighbors = std::move(neighbors);
+                                    m_result.status = completed ? SearchStatus::ok : m_check();
+                                    handle.resume();
+                                });
+    }
+
+    SearchResult<fpT> await_resume() {
+        return std::move(m_result);
+    }
+};
+
+// co_await async_search(scheduler, store, query, k, options) suspends the
+// calling coroutine without blocking a thread. The store, query and any
+// bitset referenced by the filter must stay alive until it resumes.
+template <typename fpT, typename qT>
+SearchAwaitable<fpT, qT> async_search(WorkStealingScheduler& scheduler,
+                                      const HybridStore<fpT, qT>& store,
+                                      const HybridVector<fpT, qT>& query,
+                                      size_t k,
+                                      AsyncSearchOptions options = AsyncSearchOptions()) {
+    return SearchAwaitable<fpT, qT>(scheduler, store, query, k, std::move(options));
+}
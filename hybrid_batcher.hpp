@@ -0,0 +1,167 @@
+#pragma once
+
+#include "hybrid_store.hpp"
+#include <deque>
+#include <future>
+
+// Coalesces concurrent searches against one HybridStore into batches that
+// share a single cache-blocked pass over the store. A batch is dispatched when
+// it reaches max_batch queries or its oldest query has waited latency_budget.
+// Under light load (requests arriving further apart than the budget) queries
+// are dispatched as soon as the scanner is free, so they pay no batching delay.
+template <typename fpT, typename qT>
+class QueryBatcher {
+private:
+    struct Request {
+        HybridVector<fpT, qT> query;
+        size_t k;
+        IdFilter filter;
+        std::chrono::steady_clock::time_point arrival;
+        std::promise<std::vector<Neighbor<fpT>>> promise;
+    };
+
+    const HybridStore<fpT, qT>& m_store;
+    WorkerPool& m_pool;
+    size_t m_max_batch;
+    std::chrono::microseconds m_latency_budget;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<Request> m_queue;
+    bool m_stop = false;
+
+    // Exponential moving average of the gap between arrivals
+    double m_arrival_gap_us;
+    std::chrono::steady_clock::time_point m_last_arrival;
+
+    std::atomic<size_t> m_num_batches{0};
+    std::atomic<size_t> m_num_queries{0};
+    std::thread m_dispatcher;
+
+    void m_run_batch(std::vector<Request>& batch) {
+        std::vector<const HybridVector<fpT, qT>*> queries;
+        std::vector<const IdFilter*> filters;
+        for (const Request& request : batch) {
+            queries.push_back(&request.query);
+            filters.push_back(&request.filter);
+        }
+
+        auto snapshot = m_store.snapshot();
+
+        // Pool thread t keeps its candidates for query q in tops[q], reused
+        // across batches
+        using Partial = std::vector<TopK<fpT>>;
+        std::vector<std::vector<Neighbor<fpT>>> results(batch.size());
+        auto lease = m_pool.lease();
+        m_pool.run([&](size_t t) {
+            Partial& tops = m_pool.scratch(t).get<Partial>();
+            tops.resize(batch.size());
+            for (size_t q = 0; q < batch.size(); q++) {
+                tops[q].reset(batch[q].k);
+            }
+        });
+
+        m_pool.parallel_for(snapshot.num_segments(), [&](size_t i, size_t t) {
+            Partial& tops = m_pool.scratch(t).get<Partial>();
+            snapshot.scan_segment_batch(i, queries, filters, [&](size_t q, u64 id, fpT distance) {
+                tops[q].push(id, distance);
+            });
+        });
+
+        for (size_t q = 0; q < batch.size(); q++) {
+            TopK<fpT> merged(batch[q].k);
+            for (size_t t = 0; t < m_pool.num_threads(); t++) {
+                merged.merge(m_pool.scratch(t).get<Partial>()[q]);
+            }
+            results[q] = merged.take_sorted();
+        }
+        lease.unlock();
+
+        for (size_t q = 0; q < batch.size(); q++) {
+            batch[q].promise.set_value(std::move(results[q]));
+        }
+
+        m_num_batches.fetch_add(1, std::memory_order_relaxed);
+        m_num_queries.fetch_add(batch.size(), std::memory_order_relaxed);
+    }
+
+    void m_dispatch() {
+        std::unique_lock lock(m_mutex);
+        for (;;) {
+            m_cv.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+            if (m_queue.empty()) {
+                return;
+            }
+
+            bool light_load = m_arrival_gap_us >= static_cast<double>(m_latency_budget.count());
+            if (!light_load && !m_stop) {
+                auto deadline = m_queue.front().arrival + m_latency_budget;
+                m_cv.wait_until(lock, deadline, [this] {
+                    return m_stop || m_queue.size() >= m_max_batch;
+                });
+            }
+
+            std::vector<Request> batch;
+            while (!m_queue.empty() && batch.size() < m_max_batch) {
+                batch.push_back(std::move(m_queue.front()));
+                m_queue.pop_front();
+            }
+
+            lock.unlock();
+            m_run_batch(batch);
+            lock.lock();
+        }
+    }
+
+public:
+    QueryBatcher(const HybridStore<fpT, qT>& store,
+                 size_t max_batch = 32,
+                 std::chrono::microseconds latency_budget = std::chrono::microseconds(200),
+                 WorkerPool& pool = default_worker_pool())
+        : m_store(store),
+          m_pool(pool),
+          m_max_batch(std::max<size_t>(max_batch, 1)),
+          m_latency_budget(latency_budget),
+          m_arrival_gap_us(static_cast<double>(latency_budget.count())),
+          m_last_arrival(std::chrono::steady_clock::now()) {
+        m_dispatcher = std::thread([this] { m_dispatch(); });
+    }
+
+    // Answers every query already submitted, then stops the dispatcher
+    ~QueryBatcher() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        m_dispatcher.join();
+    }
+
+    QueryBatcher(const QueryBatcher&) = delete;
+    QueryBatcher& operator=(const QueryBatcher&) = delete;
+
+    // Thread-safe. Any bitset referenced by the filter must outlive the future.
+    std::future<std::vector<Neighbor<fpT>>> submit(const HybridVector<fpT, qT>& query,
+                                                   size_t k,
+                                                   const IdFilter& filter = IdFilter()) {
+        auto now = std::chrono::steady_clock::now();
+        std::future<std::vector<Neighbor<fpT>>> future;
+        {
+            std::lock_guard lock(m_mutex);
+            double gap = std::chrono::duration<double, std::micro>(now - m_last_arrival).count();
+            m_arrival_gap_us = 0.875 * m_arrival_gap_us + 0.125 * gap;
+            m_last_arrival = now;
+
+            m_queue.push_back(Request{query, k, filter, now, {}});
+            future = m_queue.back().promise.get_future();
+        }
+        m_cv.notify_all();
+        return future;
+    }
+
+    // Mean number of queries answered per store pass so far
+    double average_batch_size() const {
+        size_t batches = m_num_batches.load(std::memory_order_relaxed);
+        return batches == 0 ? 0.0 : static_cast<double>(m_num_queries.load(std::memory_order_relaxed)) / batches;
+    }
+};
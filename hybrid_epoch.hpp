@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Epoch-based reclamation for lock-free readers. A reader pins the current
+// epoch for as long as it dereferences shared pointers; a writer that unlinks
+// an object retires it, and the object is freed only once every reader that
+// could still hold it has unpinned.
+class EpochManager {
+private:
+    static constexpr size_t max_readers = 256;
+    static constexpr std::uint64_t idle = std::numeric_limits<std::uint64_t>::max();
+
+    struct alignas(64) Slot {
+        std::atomic<std::uint64_t> epoch{idle};
+        std::atomic<bool> in_use{false};
+    };
+
+    std::atomic<std::uint64_t> m_global_epoch{1};
+    Slot m_slots[max_readers];
+
+    std::mutex m_retired_mutex;
+    std::vector<std::pair<std::uint64_t, std::function<void()>>> m_retired;
+
+    // Oldest epoch still pinned by a reader, or idle when none is
+    std::uint64_t m_min_pinned() const {
+        std::uint64_t min_epoch = idle;
+        for (const Slot& slot : m_slots) {
+            min_epoch = std::min(min_epoch, slot.epoch.load(std::memory_order_seq_cst));
+        }
+        return min_epoch;
+    }
+
+public:
+    // RAII pin on the epoch current at construction
+    class Guard {
+    private:
+        Slot* m_slot;
+
+    public:
+        explicit Guard(Slot* slot) : m_slot(slot) {}
+
+        Guard(Guard&& other) noexcept : m_slot(std::exchange(other.m_slot, nullptr)) {}
+
+        ~Guard() {
+            if (m_slot != nullptr) {
+                m_slot->epoch.store(idle, std::memory_order_release);
+                m_slot->in_use.store(false, std::memory_order_release);
+            }
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        Guard& operator=(Guard&&) = delete;
+    };
+
+    EpochManager() = default;
+
+    // Runs every deferred deleter; no reader may be pinned
+    ~EpochManager() {
+        for (auto& entry : m_retired) {
+            entry.second();
+        }
+    }
+
+    EpochManager(const EpochManager&) = delete;
+    EpochManager& operator=(const EpochManager&) = delete;
+
+    // Claims a free reader slot and publishes the current epoch in it. Shared
+    // pointers must only be loaded after pin() returns.
+    Guard pin() {
+        size_t start = std::hash<std::thread::id>()(std::this_thread::get_id());
+        for (size_t i = 0;; i++) {
+            Slot& slot = m_slots[(start + i) % max_readers];
+            bool expected = false;
+            if (!slot.in_use.load(std::memory_order_relaxed) &&
+                slot.in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                slot.epoch.store(m_global_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+                return Guard(&slot);
+            }
+            if (i % max_readers == max_readers - 1) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // Defers deleter until no reader pinned before this call remains. The
+    // object must already be unreachable for newly pinned readers.
+    void retire(std::function<void()> deleter) {
+        std::uint64_t epoch = m_global_epoch.fetch_add(1, std::memory_order_seq_cst);
+        {
+            std::lock_guard lock(m_retired_mutex);
+            m_retired.emplace_back(epoch, std::move(deleter));
+        }
+        collect();
+    }
+
+    // Frees every retired object that no pinned reader can still reach
+    void collect() {
+        std::uint64_t min_epoch = m_min_pinned();
+        std::vector<std::function<void()>> ready;
+        {
+            std::lock_guard lock(m_retired_mutex);
+            auto it = std::partition(m_retired.begin(), m_retired.end(), [&](const auto& entry) {
+                return entry.first >= min_epoch;
+            });
+            for (auto jt = it; jt != m_retired.end(); ++jt) {
+                ready.push_back(std::move(jt->second));
+            }
+            m_retired.erase(it, m_retired.end());
+        }
+        for (auto& deleter : ready) {
+            deleter();
+        }
+    }
+
+    // Blocks until every reader pinned before this call has unpinned
+    void synchronize() {
+        std::uint64_t epoch = m_global_epoch.fetch_add(1, std::memory_order_seq_cst);
+        while (m_min_pinned() <= epoch) {
+            std::this_thread::yield();
+        }
+    }
+
+    size_t num_retired() {
+        std::lock_guard lock(m_retired_mutex);
+        return m_retired.size();
+    }
+};
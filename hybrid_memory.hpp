@@ -0,0 +1,254 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Page size backing a mapping, from smallest to largest. Requests fall back
+// down this list: an explicit huge page size is used only when the kernel's
+// hugetlb pool can supply it and the array fills at least one such page,
+// otherwise the mapping gets base pages advised as transparent huge pages.
+enum class PageSize {
+    base,         // 4 KiB pages, no advice
+    transparent,  // base mapping with madvise(MADV_HUGEPAGE)
+    huge_2m,      // MAP_HUGETLB with 2 MiB pages
+    huge_1g       // MAP_HUGETLB with 1 GiB pages
+};
+
+// Fixed-size array of trivially copyable elements backed by an anonymous
+// mapping. Pages are zero-filled and only placed in physical memory on first
+// touch, which lets callers steer placement with a NUMA node hint. Large
+// arrays default to huge pages so long scans take fewer TLB misses.
+template <typename T>
+class MappedArray {
+    static_assert(std::is_trivially_copyable<T>::value, "MappedArray needs trivially copyable elements");
+
+private:
+    T* m_data = nullptr;
+    size_t m_size = 0;
+    size_t m_bytes = 0;
+    PageSize m_page_size = PageSize::base;
+
+    static size_t m_round_up(size_t bytes, size_t page) {
+        return (bytes + page - 1) / page * page;
+    }
+
+    // Tries an explicit hugetlb mapping of log2_page-sized pages; returns
+    // nullptr when the pool cannot supply it
+    static void* m_map_huge(size_t bytes, int log2_page) {
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (log2_page << MAP_HUGE_SHIFT);
+        void* addr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+        return addr == MAP_FAILED ? nullptr : addr;
+#else
+        (void)bytes;
+        (void)log2_page;
+        return nullptr;
+#endif
+    }
+
+    // Prefer (not require) pages on numa_node; silently ignored when the
+    // kernel has no NUMA support
+    static void m_bind(void* addr, size_t bytes, int numa_node) {
+#ifdef SYS_mbind
+        constexpr int mpol_preferred = 1;
+        unsigned long nodemask[1024 / (8 * sizeof(unsigned long))] = {};
+        if (numa_node < 0 || numa_node >= 1024) {
+            return;
+        }
+        nodemask[numa_node / (8 * sizeof(unsigned long))] |= 1UL << (numa_node % (8 * sizeof(unsigned long)));
+        syscall(SYS_mbind, addr, bytes, mpol_preferred, nodemask, 1024UL, 0U);
+#else
+        (void)addr;
+        (void)bytes;
+        (void)numa_node;
+#endif
+    }
+
+public:
+    MappedArray() = default;
+
+    explicit MappedArray(size_t size, int numa_node = -1, PageSize pages = PageSize::huge_2m) : m_size(size) {
+        if (size == 0) {
+            return;
+        }
+        const size_t bytes = size * sizeof(T);
+
+        void* addr = nullptr;
+        if (pages >= PageSize::huge_1g && bytes >= (size_t(1) << 30)) {
+            m_bytes = m_round_up(bytes, size_t(1) << 30);
+            addr = m_map_huge(m_bytes, 30);
+            m_page_size = PageSize::huge_1g;
+        }
+        if (addr == nullptr && pages >= PageSize::huge_2m && bytes >= (size_t(1) << 21)) {
+            m_bytes = m_round_up(bytes, size_t(1) << 21);
+            addr = m_map_huge(m_bytes, 21);
+            m_page_size = PageSize::huge_2m;
+        }
+        if (addr == nullptr) {
+            m_bytes = m_round_up(bytes, static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+            addr = mmap(nullptr, m_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (addr == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+            m_page_size = PageSize::base;
+#ifdef MADV_HUGEPAGE
+            if (pages >= PageSize::transparent && madvise(addr, m_bytes, MADV_HUGEPAGE) == 0) {
+                m_page_size = PageSize::transparent;
+            }
+#endif
+        }
+        if (numa_node >= 0) {
+            m_bind(addr, m_bytes, numa_node);
+        }
+        m_data = static_cast<T*>(addr);
+    }
+
+    ~MappedArray() {
+        if (m_data != nullptr) {
+            munmap(m_data, m_bytes);
+        }
+    }
+
+    MappedArray(MappedArray&& other) noexcept
+        : m_data(std::exchange(other.m_data, nullptr)),
+          m_size(std::exchange(other.m_size, 0)),
+          m_bytes(std::exchange(other.m_bytes, 0)),
+          m_page_size(std::exchange(other.m_page_size, PageSize::base)) {}
+
+    MappedArray& operator=(MappedArray&& other) noexcept {
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+        std::swap(m_bytes, other.m_bytes);
+        std::swap(m_page_size, other.m_page_size);
+        return *this;
+    }
+
+    MappedArray(const MappedArray&) = delete;
+    MappedArray& operator=(const MappedArray&) = delete;
+
+    T* data() { return m_data; }
+    const T* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    size_t bytes() const { return m_bytes; }
+    // Page size actually obtained; transparent means the advice was accepted,
+    // not that the kernel has already promoted any page
+    PageSize page_size() const { return m_page_size; }
+
+    T& operator[](size_t i) {
+        assert(i < m_size);
+        return m_data[i];
+    }
+
+    const T& operator[](size_t i) const {
+        assert(i < m_size);
+        return m_data[i];
+    }
+};
+
+// Fixed-size array of trivially copyable elements backed by a shared file
+// mapping, so the kernel pages it to and from disk and the array may exceed
+// physical memory. With a path the file is created if needed, resized to the
+// array and keeps its contents after the array is gone (flush() forces them
+// to disk). Without one the array lives in an unlinked temporary file under
+// $TMPDIR (default /tmp) that disappears with the mapping; this is the form
+// the size-only constructor storage policies use. File mappings get base
+// pages and no NUMA binding: the page cache decides placement.
+template <typename T>
+class FileMappedArray {
+    static_assert(std::is_trivially_copyable<T>::value, "FileMappedArray needs trivially copyable elements");
+
+private:
+    T* m_data = nullptr;
+    size_t m_size = 0;
+    size_t m_bytes = 0;
+
+    // Descriptor of an anonymous file in the temporary directory, or -1
+    static int m_open_temporary() {
+        const char* dir = std::getenv("TMPDIR");
+        std::string path = (dir != nullptr && *dir != '\0') ? dir : "/tmp";
+#ifdef O_TMPFILE
+        int fd = open(path.c_str(), O_TMPFILE | O_RDWR, 0600);
+        if (fd >= 0) {
+            return fd;
+        }
+#endif
+        path += "/hybrid-XXXXXX";
+        fd = mkstemp(path.data());
+        if (fd >= 0) {
+            unlink(path.c_str());
+        }
+        return fd;
+    }
+
+public:
+    FileMappedArray() = default;
+
+    // Throws std::bad_alloc when the file cannot be opened, sized or mapped
+    explicit FileMappedArray(size_t size, const std::string& path = std::string()) : m_size(size) {
+        const int fd = path.empty() ? m_open_temporary() : open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            throw std::bad_alloc();
+        }
+        m_bytes = size * sizeof(T);
+        void* addr = nullptr;
+        if (ftruncate(fd, static_cast<off_t>(m_bytes)) == 0 && m_bytes != 0) {
+            addr = mmap(nullptr, m_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        // The mapping keeps the file open
+        close(fd);
+        if (m_bytes != 0 && (addr == nullptr || addr == MAP_FAILED)) {
+            throw std::bad_alloc();
+        }
+        m_data = static_cast<T*>(addr);
+    }
+
+    ~FileMappedArray() {
+        if (m_data != nullptr) {
+            munmap(m_data, m_bytes);
+        }
+    }
+
+    FileMappedArray(FileMappedArray&& other) noexcept
+        : m_data(std::exchange(other.m_data, nullptr)),
+          m_size(std::exchange(other.m_size, 0)),
+          m_bytes(std::exchange(other.m_bytes, 0)) {}
+
+    FileMappedArray& operator=(FileMappedArray&& other) noexcept {
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+        std::swap(m_bytes, other.m_bytes);
+        return *this;
+    }
+
+    FileMappedArray(const FileMappedArray&) = delete;
+    FileMappedArray& operator=(const FileMappedArray&) = delete;
+
+    T* data() { return m_data; }
+    const T* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    size_t bytes() const { return m_bytes; }
+
+    // Writes dirty pages back to the file; returns false on failure
+    bool flush() {
+        return m_data == nullptr || msync(m_data, m_bytes, MS_SYNC) == 0;
+    }
+
+    T& operator[](size_t i) {
+        assert(i < m_size);
+        return m_data[i];
+    }
+
+    const T& operator[](size_t i) const {
+        assert(i < m_size);
+        return m_data[i];
+    }
+};
@@ -0,0 +1,206 @@
+#pragma once
+
+#include "hybrid_store.hpp"
+#include "hybrid_pool.hpp"
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <pthread.h>
+#include <sched.h>
+
+// Online NUMA nodes and the CPUs they own, read from sysfs. Node ids need
+// not be contiguous (offline or hot-removed nodes leave gaps), and memory-only
+// nodes are listed with no CPUs. Nodes are addressed by index; node_id() gives
+// the kernel's id for mbind. Machines without NUMA information are reported as
+// a single node with id -1 holding every online CPU.
+class NumaTopology {
+private:
+    std::vector<int> m_node_ids;
+    std::vector<std::vector<int>> m_node_cpus;
+
+    // Parses the kernel cpulist format, e.g. "0-3,8-11"
+    static std::vector<int> m_parse_cpulist(const std::string& text) {
+        std::vector<int> cpus;
+        std::stringstream ss(text);
+        std::string range;
+        while (std::getline(ss, range, ',')) {
+            if (range.empty() || range == "\n") {
+                continue;
+            }
+            size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; cpu++) {
+                cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    }
+
+    static std::string m_read_line(const std::string& path) {
+        std::ifstream file(path);
+        std::string text;
+        std::getline(file, text);
+        return text;
+    }
+
+public:
+    NumaTopology() {
+        for (int node : m_parse_cpulist(m_read_line("/sys/devices/system/node/online"))) {
+            m_node_ids.push_back(node);
+            m_node_cpus.push_back(m_parse_cpulist(
+                m_read_line("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist")));
+        }
+
+        // No NUMA information, or none readable that owns a CPU
+        const bool any_cpus = std::any_of(m_node_cpus.begin(), m_node_cpus.end(),
+                                          [](const std::vector<int>& cpus) { return !cpus.empty(); });
+        if (!any_cpus) {
+            m_node_ids.clear();
+            m_node_cpus.clear();
+            std::vector<int> cpus;
+            long online = sysconf(_SC_NPROCESSORS_ONLN);
+            for (int cpu = 0; cpu < online; cpu++) {
+                cpus.push_back(cpu);
+            }
+            m_node_ids.push_back(-1);
+            m_node_cpus.push_back(cpus);
+        }
+    }
+
+    size_t num_nodes() const { return m_node_cpus.size(); }
+    // Kernel id of the node at this index, as mbind expects it
+    int node_id(size_t node) const { return m_node_ids[node]; }
+    const std::vector<int>& cpus(size_t node) const { return m_node_cpus[node]; }
+
+    // Restricts the calling thread to the CPUs of node; returns false on failure
+    bool pin_current_thread(size_t node) const {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : m_node_cpus[node]) {
+            CPU_SET(cpu, &set);
+        }
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+    }
+};
+
+// HybridStore partitioned into one shard per NUMA node with CPUs (memory-only
+// nodes have no threads to scan them). Each shard's segments are bound to its
+// node, and the store owns a worker pool with one thread per
+// CPU pinned to that CPU's node; every thread scans only the shard local to
+// it, and per-thread top-k results are merged at the end. Shard s assigns ids
+// s, s + num_shards, s + 2 * num_shards, ...
+template <typename fpT, typename qT>
+class ShardedHybridStore {
+private:
+    NumaTopology m_topology;
+    std::vector<std::unique_ptr<HybridStore<fpT, qT>>> m_shards;
+    std::atomic<size_t> m_next_shard{0};
+    // Topology index of the node shard s lives on
+    std::vector<size_t> m_shard_node;
+
+    // Pool thread t scans shard m_thread_shard[t] as the m_thread_rank[t]-th
+    // of m_shard_threads[shard] threads on its node
+    std::vector<size_t> m_thread_shard;
+    std::vector<size_t> m_thread_rank;
+    std::vector<size_t> m_shard_threads;
+    std::unique_ptr<WorkerPool> m_pool;
+
+public:
+    // pages and keep_stats apply to every shard, see HybridStore
+    ShardedHybridStore(size_t half_size, size_t segment_capacity = 4096, PageSize pages = PageSize::huge_2m,
+                       bool keep_stats = false) {
+        for (size_t node = 0; node < m_topology.num_nodes(); node++) {
+            if (!m_topology.cpus(node).empty()) {
+                m_shard_node.push_back(node);
+            }
+        }
+        const size_t num_shards = m_shard_node.size();
+        for (size_t s = 0; s < num_shards; s++) {
+            m_shards.push_back(std::make_unique<HybridStore<fpT, qT>>(
+                half_size, segment_capacity, m_topology.node_id(m_shard_node[s]), s, num_shards, pages,
+                keep_stats));
+        }
+
+        std::vector<std::vector<int>> affinity;
+        for (size_t s = 0; s < num_shards; s++) {
+            const std::vector<int>& cpus = m_topology.cpus(m_shard_node[s]);
+            m_shard_threads.push_back(cpus.size());
+            for (size_t rank = 0; rank < cpus.size(); rank++) {
+                affinity.push_back(cpus);
+                m_thread_shard.push_back(s);
+                m_thread_rank.push_back(rank);
+            }
+        }
+        m_pool = std::make_unique<WorkerPool>(affinity.size(), affinity);
+    }
+
+    const NumaTopology& topology() const { return m_topology; }
+    size_t num_shards() const { return m_shards.size(); }
+    // Topology index of the node holding shard s
+    size_t shard_node(size_t s) const { return m_shard_node[s]; }
+    WorkerPool& pool() { return *m_pool; }
+    HybridStore<fpT, qT>& shard(size_t s) { return *m_shards[s]; }
+    const HybridStore<fpT, qT>& shard(size_t s) const { return *m_shards[s]; }
+
+    size_t size() const {
+        size_t total = 0;
+        for (const auto& shard : m_shards) {
+            total += shard->size();
+        }
+        return total;
+    }
+
+    // Thread-safe; rows are spread round-robin over the shards
+    u64 insert(const HybridVector<fpT, qT>& vec) {
+        size_t s = m_next_shard.fetch_add(1, std::memory_order_relaxed) % m_shards.size();
+        return m_shards[s]->insert(vec);
+    }
+
+    bool erase(u64 id) {
+        return m_shards[id % m_shards.size()]->erase(id);
+    }
+
+    bool contains(u64 id) const {
+        return m_shards[id % m_shards.size()]->contains(id);
+    }
+
+    void start_compaction(std::chrono::milliseconds interval, double min_dead_ratio = 0.25) {
+        for (auto& shard : m_shards) {
+            shard->start_compaction(interval, min_dead_ratio);
+        }
+    }
+
+    void stop_compaction() {
+        for (auto& shard : m_shards) {
+            shard->stop_compaction();
+        }
+    }
+
+    // Pool thread t scans a stripe of the shard on its own node. Each thread
+    // keeps its top-k heap in pool scratch, so no allocation per query.
+    std::vector<Neighbor<fpT>> search(const HybridVector<fpT, qT>& query,
+                                      size_t k,
+                                      const IdFilter& filter = IdFilter()) const {
+        std::vector<typename HybridStore<fpT, qT>::Snapshot> snapshots;
+        for (const auto& shard : m_shards) {
+            snapshots.push_back(shard->snapshot());
+        }
+
+        auto lease = m_pool->lease();
+        m_pool->run([&](size_t t) {
+            auto& top = m_pool->scratch(t).get<TopK<fpT>>();
+            top.reset(k);
+            size_t s = m_thread_shard[t];
+            snapshots[s].scan_blocks(query, filter, [&](const size_t* ids, const fpT* distances, size_t n) {
+                top.push_block(ids, distances, n);
+            }, m_thread_rank[t], m_shard_threads[s]);
+        });
+
+        TopK<fpT> merged(k);
+        for (size_t t = 0; t < m_pool->num_threads(); t++) {
+            merged.merge(m_pool->scratch(t).get<TopK<fpT>>());
+        }
+        return merged.take_sorted();
+    }
+};
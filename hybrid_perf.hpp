@@ -0,0 +1,190 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+// One event for PerfCounters, as perf_event_attr type and config
+struct PerfEvent {
+    std::string name;
+    std::uint32_t type;
+    std::uint64_t config;
+};
+
+inline constexpr std::uint64_t perf_cache_event(std::uint64_t cache, std::uint64_t op, std::uint64_t result) {
+    return cache | (op << 8) | (result << 16);
+}
+
+// Generic events every PMU driver maps: cycles, instructions, L1D read
+// misses, last-level cache misses and dTLB read misses
+inline std::vector<PerfEvent> perf_default_events() {
+    return {
+        {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {"L1D_misses", PERF_TYPE_HW_CACHE,
+         perf_cache_event(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+        {"LLC_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {"dTLB_misses", PERF_TYPE_HW_CACHE,
+         perf_cache_event(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+    };
+}
+
+// Uops dispatched to the ALU ports (0, 1, 5, 6) on Intel cores whose
+// encodings are known, as raw event | umask << 8. Vector FP and vector
+// integer work share ports 0, 1 and 5, so these show how the interleaved
+// kernel's two halves actually spread. Empty on other CPUs.
+inline std::vector<PerfEvent> perf_port_events() {
+    std::vector<PerfEvent> events;
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx) || ebx != 0x756e6547) {  // "Genu"ineIntel
+        return events;
+    }
+    __get_cpuid(1, &eax, &ebx, &ecx, &edx);
+    const unsigned family = (eax >> 8) & 0xf;
+    const unsigned model = ((eax >> 4) & 0xf) | (((eax >> 16) & 0xf) << 4);
+    if (family != 6) {
+        return events;
+    }
+
+    std::uint64_t event = 0;
+    switch (model) {
+        // Skylake, Cascade Lake, Kaby/Coffee/Comet Lake: UOPS_DISPATCHED_PORT
+        case 0x4e: case 0x5e: case 0x55: case 0x8e: case 0x9e: case 0xa5: case 0xa6:
+            event = 0xa1;
+            break;
+        // Ice Lake, Tiger Lake, Sapphire/Emerald Rapids: UOPS_DISPATCHED
+        case 0x6a: case 0x6c: case 0x7d: case 0x7e: case 0x8c: case 0x8d: case 0x8f: case 0xcf:
+            event = 0xb2;
+            break;
+        default:
+            return events;
+    }
+    // Port 5 and 6 umasks match across both generations
+    events = {
+        {"port0", PERF_TYPE_RAW, event | (0x01 << 8)},
+        {"port1", PERF_TYPE_RAW, event | (0x02 << 8)},
+        {"port5", PERF_TYPE_RAW, event | (0x20 << 8)},
+        {"port6", PERF_TYPE_RAW, event | (0x40 << 8)},
+    };
+#endif
+    return events;
+}
+
+// Parses "name:rXXXX,..." (perf's raw syntax, hex config) into raw events;
+// malformed entries are skipped
+inline std::vector<PerfEvent> perf_parse_raw_events(const std::string& list) {
+    std::vector<PerfEvent> events;
+    size_t begin = 0;
+    while (begin < list.size()) {
+        size_t end = list.find(',', begin);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        const std::string entry = list.substr(begin, end - begin);
+        const size_t colon = entry.find(':');
+        if (colon != std::string::npos && colon + 1 < entry.size() && entry[colon + 1] == 'r') {
+            char* parse_end = nullptr;
+            const std::uint64_t config = std::strtoull(entry.c_str() + colon + 2, &parse_end, 16);
+            if (parse_end != entry.c_str() + colon + 2 && *parse_end == '\0') {
+                events.push_back({entry.substr(0, colon), PERF_TYPE_RAW, config});
+            }
+        }
+        begin = end + 1;
+    }
+    return events;
+}
+
+// Counts events on the calling thread, user space only, between start() and
+// stop(). Events the kernel refuses (no PMU in a VM, perf_event_paranoid,
+// unknown raw encodings) are dropped at construction, so events() lists what
+// is actually counted and an empty set makes start/stop no-ops. Events are
+// opened separately rather than as a group, so more events than hardware
+// counters are multiplexed and read() scales each by its enabled/running time.
+class PerfCounters {
+private:
+    std::vector<PerfEvent> m_events;
+    std::vector<int> m_fds;
+
+    static int m_open(const PerfEvent& event) {
+        perf_event_attr attr = {};
+        attr.size = sizeof(attr);
+        attr.type = event.type;
+        attr.config = event.config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+public:
+    explicit PerfCounters(const std::vector<PerfEvent>& events = perf_default_events()) {
+        for (const PerfEvent& event : events) {
+            int fd = m_open(event);
+            if (fd >= 0) {
+                m_events.push_back(event);
+                m_fds.push_back(fd);
+            }
+        }
+    }
+
+    ~PerfCounters() {
+        for (int fd : m_fds) {
+            close(fd);
+        }
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    const std::vector<PerfEvent>& events() const { return m_events; }
+    size_t size() const { return m_events.size(); }
+    bool empty() const { return m_events.empty(); }
+
+    // Index of the event called name, or size() if it is not counted
+    size_t find(const std::string& name) const {
+        size_t i = 0;
+        while (i < m_events.size() && m_events[i].name != name) {
+            i++;
+        }
+        return i;
+    }
+
+    void start() {
+        for (int fd : m_fds) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        }
+        for (int fd : m_fds) {
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    void stop() {
+        for (int fd : m_fds) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+
+    // Counts since the last start(), in events() order, extrapolated to the
+    // full enabled time when an event was multiplexed; 0 if it never ran
+    std::vector<double> read() const {
+        std::vector<double> counts(m_fds.size(), 0.0);
+        for (size_t i = 0; i < m_fds.size(); i++) {
+            std::uint64_t values[3] = {};  // value, time enabled, time running
+            if (::read(m_fds[i], values, sizeof(values)) != sizeof(values) || values[2] == 0) {
+                continue;
+            }
+            counts[i] = static_cast<double>(values[0]) * (static_cast<double>(values[1]) / values[2]);
+        }
+        return counts;
+    }
+};
@@ -0,0 +1,338 @@
+#pragma once
+
+// Requires C++20 (-std=c++20) for concepts
+#include "hybrid_search.hpp"
+#include "hybrid_memory.hpp"
+#include <concepts>
+
+// Policy-based hybrid vectors. The quantizer, the distance metric and the
+// storage backend are template parameters checked by concepts, so each
+// combination (e.g. symmetric int8 + inner product + mmap storage) is its own
+// compiled type with the kernels inlined; nothing is dispatched at run time.
+// HybridVector itself is unchanged and stays the default.
+
+// Affine code mapping shared by all quantizers: value ≈ scale * code + bias.
+// A scale of 0 means every quantized value equals bias.
+template <typename fpT>
+struct QuantParams {
+    fpT scale = 0;
+    fpT bias = 0;
+};
+
+template <typename fpT, typename codeT>
+fpT dequantize(codeT code, const QuantParams<fpT>& params) {
+    return params.scale * static_cast<fpT>(code) + params.bias;
+}
+
+// Quantizer policy: Q::fit derives parameters from the values to be
+// quantized, Q::encode maps one value to its code
+template <typename Q, typename fpT>
+concept QuantizerPolicy =
+    std::integral<typename Q::code_type> && sizeof(typename Q::code_type) == 1 &&
+    requires(const fpT* values, size_t n, fpT x, const QuantParams<fpT>& params) {
+        { Q::template fit<fpT>(values, n) } -> std::same_as<QuantParams<fpT>>;
+        { Q::encode(x, params) } -> std::same_as<typename Q::code_type>;
+    };
+
+// Min/max scaling onto [0, max code]. Unlike HybridVector, the range is
+// fitted over the quantized half only and codes are rounded to nearest
+// rather than truncated, so codes for the same input can differ by one.
+template <typename qT = std::uint8_t>
+struct MinMaxQuantizer {
+    using code_type = qT;
+
+    template <typename fpT>
+    static QuantParams<fpT> fit(const fpT* values, size_t n) {
+        if (n == 0) {
+            return {};
+        }
+        auto [lo, hi] = std::minmax_element(values, values + n);
+        return {(*hi - *lo) / static_cast<fpT>(std::numeric_limits<qT>::max()), *lo};
+    }
+
+    template <typename fpT>
+    static qT encode(fpT x, const QuantParams<fpT>& params) {
+        if (params.scale == 0) {
+            return 0;
+        }
+        fpT code = (x - params.bias) / params.scale + static_cast<fpT>(0.5);
+        return static_cast<qT>(std::clamp(code, static_cast<fpT>(0),
+                                          static_cast<fpT>(std::numeric_limits<qT>::max())));
+    }
+};
+
+// Symmetric int8: codes in [-127, 127] around zero with no bias, so products
+// of codes are products of values up to the two scales
+struct SymmetricInt8Quantizer {
+    using code_type = std::int8_t;
+
+    template <typename fpT>
+    static QuantParams<fpT> fit(const fpT* values, size_t n) {
+        fpT max_abs = 0;
+        for (size_t i = 0; i < n; i++) {
+            max_abs = std::max(max_abs, std::abs(values[i]));
+        }
+        return {max_abs / static_cast<fpT>(127), 0};
+    }
+
+    template <typename fpT>
+    static std::int8_t encode(fpT x, const QuantParams<fpT>& params) {
+        if (params.scale == 0) {
+            return 0;
+        }
+        fpT code = std::clamp(x / params.scale, static_cast<fpT>(-127), static_cast<fpT>(127));
+        return static_cast<std::int8_t>(std::lround(code));
+    }
+};
+
+// Non-owning view of one policy row: half_size fp values, half_size codes,
+// their parameters and the sum of the codes
+template <typename fpT, typename codeT>
+struct HybridRowView {
+    const fpT* fp;
+    const codeT* q;
+    size_t half_size;
+    QuantParams<fpT> params;
+    std::int64_t code_sum;
+};
+
+// Metric policy: M::distance returns a dissimilarity where smaller is closer
+template <typename M, typename fpT, typename codeT>
+concept MetricPolicy = requires(const HybridRowView<fpT, codeT>& a, const HybridRowView<fpT, codeT>& b) {
+    { M::distance(a, b) } -> std::same_as<fpT>;
+};
+
+// Squared Euclidean distance with the linearized q half of HybridVector:
+// the q half contributes scale_a * scale_b * Σ(code_a - code_b)²
+struct SquaredEuclidean {
+    template <typename fpT, typename codeT>
+    static fpT distance(const HybridRowView<fpT, codeT>& a, const HybridRowView<fpT, codeT>& b) {
+        assert(a.half_size == b.half_size);
+        return hybrid_squared_distance(a.fp, a.q, b.fp, b.q, a.half_size, a.params.scale * b.params.scale);
+    }
+};
+
+// Dot products of the fp halves and of the raw codes in one interleaved pass,
+// with the lane layout and integer flushing of hybrid_squared_distance. A code
+// product is bounded like a squared difference, so HybridCodeAccumulator's
+// widths and flush interval apply unchanged.
+template <typename fpT, typename codeT>
+void hybrid_dot_products(const fpT* a_fp, const codeT* a_q,
+                         const fpT* b_fp, const codeT* b_q,
+                         size_t n, fpT& fp_dot, std::int64_t& code_dot) {
+    using diff_t = typename HybridCodeAccumulator<codeT>::diff_t;
+    using acc_t = typename HybridCodeAccumulator<codeT>::acc_t;
+    constexpr size_t lanes = hybrid_kernel_lanes;
+    constexpr size_t flush_steps = HybridCodeAccumulator<codeT>::flush_steps;
+
+    fpT fp_acc[lanes] = {};
+    std::int64_t q_total = 0;
+
+    const size_t body = n - n % lanes;
+    size_t i = 0;
+    while (i < body) {
+        const size_t block_end = (body - i > lanes * flush_steps) ? i + lanes * flush_steps : body;
+        acc_t q_acc[lanes] = {};
+
+        for (; i < block_end; i += lanes) {
+#pragma omp simd
+            for (size_t j = 0; j < lanes; j++) {
+                fp_acc[j] += a_fp[i + j] * b_fp[i + j];
+                q_acc[j] += static_cast<acc_t>(static_cast<diff_t>(a_q[i + j])) * static_cast<diff_t>(b_q[i + j]);
+            }
+        }
+
+        for (size_t j = 0; j < lanes; j++) {
+            q_total += q_acc[j];
+        }
+    }
+
+    fpT fp_sum = 0;
+    for (size_t j = 0; j < lanes; j++) {
+        fp_sum += fp_acc[j];
+    }
+
+    for (; i < n; i++) {
+        fp_sum += a_fp[i] * b_fp[i];
+        q_total += static_cast<std::int64_t>(a_q[i]) * static_cast<std::int64_t>(b_q[i]);
+    }
+
+    fp_dot = fp_sum;
+    code_dot = q_total;
+}
+
+// Negated inner product. The q half is exact for affine codes:
+// Σ(sa*a + ba)(sb*b + bb) = sa*sb*Σab + sa*bb*Σa + ba*sb*Σb + n*ba*bb,
+// so only the integer dot product Σab depends on both rows.
+struct InnerProduct {
+    template <typename fpT, typename codeT>
+    static fpT distance(const HybridRowView<fpT, codeT>& a, const HybridRowView<fpT, codeT>& b) {
+        assert(a.half_size == b.half_size);
+
+        fpT fp_dot;
+        std::int64_t code_dot;
+        hybrid_dot_products(a.fp, a.q, b.fp, b.q, a.half_size, fp_dot, code_dot);
+
+        const QuantParams<fpT>& pa = a.params;
+        const QuantParams<fpT>& pb = b.params;
+        fpT q_dot = pa.scale * pb.scale * static_cast<fpT>(code_dot) +
+                    pa.scale * pb.bias * static_cast<fpT>(a.code_sum) +
+                    pa.bias * pb.scale * static_cast<fpT>(b.code_sum) +
+                    static_cast<fpT>(a.half_size) * pa.bias * pb.bias;
+        return -(fp_dot + q_dot);
+    }
+};
+
+// Storage policy: S is constructed with an element count and exposes a
+// contiguous buffer. std::vector (heap), MappedArray (anonymous mmap with NUMA
+// and huge page placement) and FileMappedArray (file-backed mmap, paged to
+// disk) all qualify as-is.
+template <typename S, typename T>
+concept StoragePolicy =
+    std::constructible_from<S, size_t> && requires(S& s, const S& cs) {
+        { s.data() } -> std::same_as<T*>;
+        { cs.data() } -> std::same_as<const T*>;
+        { cs.size() } -> std::convertible_to<size_t>;
+    };
+
+template <typename T>
+using HeapStorage = std::vector<T>;
+
+template <typename T>
+using MappedStorage = MappedArray<T>;
+
+// Rows spill to an unlinked temporary file, so a collection can be larger
+// than physical memory. Only the row buffers are file-backed; per-row
+// parameters stay on the heap, so this is not a persistence format.
+template <typename T>
+using FileMappedStorage = FileMappedArray<T>;
+
+// One vector under the given policies. Like HybridVector, the first
+// size / 2 values are kept as fpT and the next size / 2 are quantized (an odd
+// last value is dropped); the quantizer is fitted to the quantized half only.
+template <typename fpT,
+          typename Quantizer = MinMaxQuantizer<>,
+          typename Metric = SquaredEuclidean,
+          template <typename> class Storage = HeapStorage>
+    requires QuantizerPolicy<Quantizer, fpT> &&
+             MetricPolicy<Metric, fpT, typename Quantizer::code_type> &&
+             StoragePolicy<Storage<fpT>, fpT> &&
+             StoragePolicy<Storage<typename Quantizer::code_type>, typename Quantizer::code_type>
+class BasicHybridVector {
+public:
+    using code_type = typename Quantizer::code_type;
+    using row_view = HybridRowView<fpT, code_type>;
+
+private:
+    size_t m_half_size;
+    Storage<fpT> m_fp_half;
+    Storage<code_type> m_q_half;
+    QuantParams<fpT> m_params;
+    std::int64_t m_code_sum = 0;
+
+public:
+    explicit BasicHybridVector(const std::vector<fpT>& vec)
+        : m_half_size(vec.size() / 2), m_fp_half(m_half_size), m_q_half(m_half_size) {
+        const fpT* quantized = vec.data() + m_half_size;
+        m_params = Quantizer::template fit<fpT>(quantized, m_half_size);
+
+        std::copy(vec.data(), quantized, m_fp_half.data());
+        code_type* q = m_q_half.data();
+        for (size_t i = 0; i < m_half_size; i++) {
+            q[i] = Quantizer::encode(quantized[i], m_params);
+            m_code_sum += q[i];
+        }
+    }
+
+    size_t half_size() const { return m_half_size; }
+    const fpT* fp_half() const { return m_fp_half.data(); }
+    const code_type* q_half() const { return m_q_half.data(); }
+    const QuantParams<fpT>& params() const { return m_params; }
+    std::int64_t code_sum() const { return m_code_sum; }
+
+    row_view row() const {
+        return {m_fp_half.data(), m_q_half.data(), m_half_size, m_params, m_code_sum};
+    }
+
+    fpT distance_to(const row_view& other) const { return Metric::distance(row(), other); }
+    fpT distance_to(const BasicHybridVector& other) const { return distance_to(other.row()); }
+};
+
+// Fixed-capacity collection of rows under the same policies, stored as two
+// contiguous Storage buffers (e.g. MappedStorage for an mmap-backed store)
+template <typename fpT,
+          typename Quantizer = MinMaxQuantizer<>,
+          typename Metric = SquaredEuclidean,
+          template <typename> class Storage = HeapStorage>
+    requires QuantizerPolicy<Quantizer, fpT> &&
+             MetricPolicy<Metric, fpT, typename Quantizer::code_type> &&
+             StoragePolicy<Storage<fpT>, fpT> &&
+             StoragePolicy<Storage<typename Quantizer::code_type>, typename Quantizer::code_type>
+class BasicHybridCollection {
+public:
+    using code_type = typename Quantizer::code_type;
+    using row_view = HybridRowView<fpT, code_type>;
+
+private:
+    size_t m_half_size;
+    size_t m_capacity;
+    size_t m_size = 0;
+    Storage<fpT> m_fp;
+    Storage<code_type> m_q;
+    std::vector<QuantParams<fpT>> m_params;
+    std::vector<std::int64_t> m_code_sums;
+
+public:
+    BasicHybridCollection(size_t capacity, size_t half_size)
+        : m_half_size(half_size), m_capacity(capacity),
+          m_fp(capacity * half_size), m_q(capacity * half_size) {
+        m_params.reserve(capacity);
+        m_code_sums.reserve(capacity);
+    }
+
+    size_t size() const { return m_size; }
+    size_t capacity() const { return m_capacity; }
+    size_t half_size() const { return m_half_size; }
+
+    // Copies a row (e.g. BasicHybridVector::row() under any storage policy)
+    // into the next free slot; returns its id
+    size_t insert(const row_view& vec) {
+        assert(m_size < m_capacity);
+        assert(vec.half_size == m_half_size);
+
+        const size_t id = m_size++;
+        std::copy(vec.fp, vec.fp + m_half_size, m_fp.data() + id * m_half_size);
+        std::copy(vec.q, vec.q + m_half_size, m_q.data() + id * m_half_size);
+        m_params.push_back(vec.params);
+        m_code_sums.push_back(vec.code_sum);
+        return id;
+    }
+
+    row_view row(size_t id) const {
+        assert(id < m_size);
+        return {m_fp.data() + id * m_half_size, m_q.data() + id * m_half_size,
+                m_half_size, m_params[id], m_code_sums[id]};
+    }
+
+    // The k rows allowed by the filter with the smallest Metric distance
+    std::vector<Neighbor<fpT>> search(const row_view& query,
+                                      size_t k,
+                                      const IdFilter& filter = IdFilter()) const {
+        assert(query.half_size == m_half_size);
+
+        TopK<fpT> top(k);
+        size_t ids[64];
+        fpT distances[64];
+        size_t n = 0;
+        filter.for_each_allowed(0, m_size, [&](size_t id) {
+            ids[n] = id;
+            distances[n] = Metric::distance(query, row(id));
+            if (++n == 64) {
+                top.push_block(ids, distances, n);
+                n = 0;
+            }
+        });
+        top.push_block(ids, distances, n);
+        return top.take_sorted();
+    }
+};
@@ -0,0 +1,292 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cassert>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Objects owned by one pool thread for the lifetime of the pool, created on
+// first use and reused by every later job (top-k heaps, distance buffers...).
+// One object per type; jobs reset them rather than reallocating.
+class WorkerScratch {
+private:
+    std::unordered_map<std::type_index, std::shared_ptr<void>> m_objects;
+
+public:
+    template <typename T>
+    T& get() {
+        auto& object = m_objects[std::type_index(typeid(T))];
+        if (!object) {
+            object = std::make_shared<T>();
+        }
+        return *static_cast<T*>(object.get());
+    }
+};
+
+// Threads currently runnable on the machine (the "running/total" field of
+// /proc/loadavg), including the caller; 1 when unavailable
+inline size_t runnable_threads() {
+    std::ifstream file("/proc/loadavg");
+    double load1, load5, load15;
+    size_t running = 0;
+    char slash;
+    if (!(file >> load1 >> load5 >> load15 >> running >> slash)) {
+        return 1;
+    }
+    return std::max<size_t>(running, 1);
+}
+
+// Persistent fork-join pool replacing per-call OpenMP parallel regions. Each
+// thread can be pinned to its own CPU set. Idle threads spin for a while
+// before parking on a condition variable, so back-to-back jobs skip the wake
+// up cost while a quiet pool does not burn CPU.
+class WorkerPool {
+private:
+    struct alignas(64) Thread {
+        std::thread thread;
+        std::vector<int> cpus;
+        WorkerScratch scratch;
+        // Generation of the last job this thread was handed; it parks on
+        // wake_cv until run() bumps it
+        std::atomic<std::uint64_t> generation{0};
+        std::condition_variable wake_cv;
+    };
+
+    std::vector<std::unique_ptr<Thread>> m_threads;
+    size_t m_spin_iterations;
+
+    // Serialises callers; a pool runs one job at a time. Recursive so a
+    // caller holding a lease() can still call run().
+    std::recursive_mutex m_run_mutex;
+
+    std::mutex m_mutex;
+    std::condition_variable m_done_cv;
+    std::uint64_t m_generation = 0;  // guarded by m_run_mutex
+    std::atomic<size_t> m_remaining{0};
+    const std::function<void(size_t)>* m_job = nullptr;
+    std::atomic<bool> m_busy{false};
+    bool m_stop = false;
+
+    // Pool threads not parked (spinning or running a job); they show up as
+    // runnable in /proc/loadavg but are not load competing with a job
+    std::atomic<size_t> m_awake{0};
+    // Last idle_cpus() sample and when it was taken
+    mutable std::atomic<size_t> m_idle_cpus;
+    mutable std::atomic<std::int64_t> m_idle_sampled_at{INT64_MIN / 2};
+
+    static void m_pause() {
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+    // Pool owning the calling thread, or nullptr outside any pool
+    static const WorkerPool*& m_owner() {
+        thread_local const WorkerPool* owner = nullptr;
+        return owner;
+    }
+
+    static void m_pin(const std::vector<int>& cpus) {
+        if (cpus.empty()) {
+            return;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus) {
+            CPU_SET(cpu, &set);
+        }
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    void m_run(size_t t) {
+        Thread& self = *m_threads[t];
+        m_pin(self.cpus);
+        m_owner() = this;
+        m_awake.fetch_add(1, std::memory_order_relaxed);
+        std::uint64_t seen = 0;
+
+        for (;;) {
+            // Spin first: a job usually follows closely on the previous one
+            for (size_t i = 0; i < m_spin_iterations && self.generation.load(std::memory_order_acquire) == seen; i++) {
+                m_pause();
+            }
+            if (self.generation.load(std::memory_order_acquire) == seen) {
+                std::unique_lock lock(m_mutex);
+                m_awake.fetch_sub(1, std::memory_order_relaxed);
+                self.wake_cv.wait(lock, [&] {
+                    return m_stop || self.generation.load(std::memory_order_acquire) != seen;
+                });
+                if (m_stop) {
+                    return;
+                }
+                m_awake.fetch_add(1, std::memory_order_relaxed);
+            }
+            seen = self.generation.load(std::memory_order_acquire);
+
+            (*m_job)(t);
+
+            if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard lock(m_mutex);
+                m_done_cv.notify_one();
+            }
+        }
+    }
+
+public:
+    // affinity[t] lists the CPUs thread t is pinned to; missing or empty
+    // entries leave that thread unpinned
+    explicit WorkerPool(size_t num_threads = std::thread::hardware_concurrency(),
+                        std::vector<std::vector<int>> affinity = {},
+                        size_t spin_iterations = 4096)
+        : m_spin_iterations(spin_iterations),
+          m_idle_cpus(std::max<size_t>(std::thread::hardware_concurrency(), 1)) {
+        num_threads = std::max<size_t>(num_threads, 1);
+        for (size_t t = 0; t < num_threads; t++) {
+            m_threads.push_back(std::make_unique<Thread>());
+            if (t < affinity.size()) {
+                m_threads[t]->cpus = affinity[t];
+            }
+        }
+        for (size_t t = 0; t < num_threads; t++) {
+            m_threads[t]->thread = std::thread([this, t] { m_run(t); });
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_stop = true;
+        }
+        for (auto& thread : m_threads) {
+            thread->wake_cv.notify_one();
+        }
+        for (auto& thread : m_threads) {
+            thread->thread.join();
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    size_t num_threads() const { return m_threads.size(); }
+
+    // Scratch of pool thread t; only that thread may use it during a job
+    WorkerScratch& scratch(size_t t) { return m_threads[t]->scratch; }
+
+    // True while a job is running, including when called from inside one
+    bool busy() const { return m_busy.load(std::memory_order_relaxed); }
+
+    // True when called from one of this pool's own threads
+    bool on_pool_thread() const { return m_owner() == this; }
+
+    // How often idle_cpus() re-reads /proc/loadavg
+    static constexpr std::chrono::milliseconds idle_sample_interval{100};
+
+    // CPUs not taken by other work, counting neither this pool's awake
+    // threads nor the caller. Sampled at most once per idle_sample_interval,
+    // so frequent callers (every auto-mode query) do not read /proc on their
+    // latency path; at least 1.
+    size_t idle_cpus() const {
+        const std::int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        std::int64_t sampled_at = m_idle_sampled_at.load(std::memory_order_relaxed);
+        const std::int64_t interval = std::chrono::nanoseconds(idle_sample_interval).count();
+        if (now - sampled_at >= interval &&
+            m_idle_sampled_at.compare_exchange_strong(sampled_at, now, std::memory_order_relaxed)) {
+            const size_t cpus = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+            const size_t own = m_awake.load(std::memory_order_relaxed) + 1;
+            const size_t runnable = runnable_threads();
+            const size_t others = runnable > own ? runnable - own : 0;
+            m_idle_cpus.store(cpus > others ? cpus - others : 1, std::memory_order_relaxed);
+        }
+        return m_idle_cpus.load(std::memory_order_relaxed);
+    }
+
+    // Keeps other callers out of the pool until the returned lock is
+    // released, so scratch a job filled can be read, and further run() calls
+    // made, before anyone else's job resets it. Must not be taken from
+    // inside a job of the same pool.
+    std::unique_lock<std::recursive_mutex> lease() {
+        assert(m_owner() != this && "WorkerPool::lease called from inside one of its own jobs");
+        return std::unique_lock<std::recursive_mutex>(m_run_mutex);
+    }
+
+    // Calls job(t) once on pool threads t < num_threads (all by default) and
+    // returns when all are done. Only those threads are woken and waited
+    // for; the rest stay parked or spinning. Must not be called from inside
+    // a job of the same pool. Another caller may reuse scratch as soon as
+    // this returns; read results a job left there under a lease().
+    void run(const std::function<void(size_t)>& job, size_t num_threads = SIZE_MAX) {
+        assert(m_owner() != this && "WorkerPool::run called from inside one of its own jobs");
+
+        const size_t participants = std::min(num_threads, m_threads.size());
+        if (participants == 0) {
+            return;
+        }
+
+        std::lock_guard run_lock(m_run_mutex);
+        m_busy.store(true, std::memory_order_relaxed);
+        m_job = &job;
+        m_remaining.store(participants, std::memory_order_relaxed);
+        const std::uint64_t generation = ++m_generation;
+        {
+            std::lock_guard lock(m_mutex);
+            for (size_t t = 0; t < participants; t++) {
+                m_threads[t]->generation.store(generation, std::memory_order_release);
+            }
+        }
+        for (size_t t = 0; t < participants; t++) {
+            m_threads[t]->wake_cv.notify_one();
+        }
+
+        for (size_t i = 0; i < m_spin_iterations && m_remaining.load(std::memory_order_acquire) != 0; i++) {
+            m_pause();
+        }
+        std::unique_lock lock(m_mutex);
+        m_done_cv.wait(lock, [this] { return m_remaining.load(std::memory_order_acquire) == 0; });
+        m_busy.store(false, std::memory_order_relaxed);
+    }
+
+    // Calls fn(i, t) for every i in [0, n), handing out chunks of grain
+    // indices dynamically; t is the pool thread running the call
+    template <typename Fn>
+    void parallel_for(size_t n, Fn&& fn, size_t grain = 1) {
+        std::atomic<size_t> next{0};
+        grain = std::max<size_t>(grain, 1);
+        run([&](size_t t) {
+            for (;;) {
+                size_t begin = next.fetch_add(grain, std::memory_order_relaxed);
+                if (begin >= n) {
+                    return;
+                }
+                size_t end = std::min(begin + grain, n);
+                for (size_t i = begin; i < end; i++) {
+                    fn(i, t);
+                }
+            }
+        });
+    }
+};
+
+// Process-wide pool used by library functions that are not given one
+inline WorkerPool& default_worker_pool() {
+    static WorkerPool pool;
+    return pool;
+}
@@ -0,0 +1,293 @@
+#pragma once
+
+#include "hybrid_store.hpp"
+#include <deque>
+#include <functional>
+#include <future>
+
+// How searches submitted to a WorkStealingScheduler are split into tasks
+enum class QueryParallelism {
+    inter_query,  // one task per query; concurrent queries run side by side
+    intra_query,  // every query is split into segment-stripe tasks
+    adaptive      // split only large queries (by k or collection size)
+};
+
+struct SchedulerPolicy {
+    QueryParallelism parallelism = QueryParallelism::adaptive;
+    size_t large_query_k = 100;           // adaptive: split when k is at least this
+    size_t large_query_rows = 1 << 16;    // adaptive: split when the store has at least this many rows
+    size_t tasks_per_worker = 4;          // split granularity for large queries
+};
+
+// Fixed pool of workers, each owning a task deque. Owners push and pop at
+// the back; idle workers steal from the front of a victim's deque, so a
+// large scan split into many tasks spreads over every idle core while small
+// queries stay on the worker that picked them up.
+class WorkStealingScheduler {
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::vector<std::thread> m_threads;
+    // Guards m_policy against set_policy() racing with submitters
+    mutable std::mutex m_policy_mutex;
+    SchedulerPolicy m_policy;
+
+    std::atomic<size_t> m_pending{0};
+    std::atomic<size_t> m_next_victim{0};
+    std::mutex m_idle_mutex;
+    std::condition_variable m_idle_cv;
+    bool m_stop = false;
+
+    // Index of the calling worker in its scheduler, or -1 for outside threads
+    static int& m_worker_index() {
+        thread_local int index = -1;
+        return index;
+    }
+
+    static const WorkStealingScheduler*& m_worker_owner() {
+        thread_local const WorkStealingScheduler* owner = nullptr;
+        return owner;
+    }
+
+    bool m_pop_local(size_t w, std::function<void()>& task) {
+        Worker& worker = *m_workers[w];
+        std::lock_guard lock(worker.mutex);
+        if (worker.tasks.empty()) {
+            return false;
+        }
+        task = std::move(worker.tasks.back());
+        worker.tasks.pop_back();
+        return true;
+    }
+
+    bool m_steal(size_t thief, std::function<void()>& task) {
+        const size_t n = m_workers.size();
+        const size_t start = m_next_victim.fetch_add(1, std::memory_order_relaxed);
+        for (size_t i = 0; i < n; i++) {
+            size_t victim = (start + i) % n;
+            if (victim == thief) {
+                continue;
+            }
+            Worker& worker = *m_workers[victim];
+            std::lock_guard lock(worker.mutex);
+            if (!worker.tasks.empty()) {
+                task = std::move(worker.tasks.front());
+                worker.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool m_try_run_one(size_t w) {
+        std::function<void()> task;
+        if (m_pop_local(w, task) || m_steal(w, task)) {
+            m_pending.fetch_sub(1, std::memory_order_relaxed);
+            task();
+            return true;
+        }
+        return false;
+    }
+
+    void m_run(size_t w) {
+        m_worker_index() = static_cast<int>(w);
+        m_worker_owner() = this;
+
+        for (;;) {
+            if (m_try_run_one(w)) {
+                continue;
+            }
+
+            std::unique_lock lock(m_idle_mutex);
+            m_idle_cv.wait(lock, [this] {
+                return m_stop || m_pending.load(std::memory_order_relaxed) > 0;
+            });
+            if (m_stop && m_pending.load(std::memory_order_relaxed) == 0) {
+                return;
+            }
+        }
+    }
+
+    // Number of tasks a search over rows with the given k is split into
+    size_t m_num_parts(size_t rows, size_t k, size_t num_segments) const {
+        const SchedulerPolicy policy = this->policy();
+        bool split = false;
+        switch (policy.parallelism) {
+            case QueryParallelism::inter_query:
+                split = false;
+                break;
+            case QueryParallelism::intra_query:
+                split = true;
+                break;
+            case QueryParallelism::adaptive:
+                split = k >= policy.large_query_k || rows >= policy.large_query_rows;
+                break;
+        }
+        if (!split) {
+            return 1;
+        }
+        size_t parts = m_workers.size() * policy.tasks_per_worker;
+        return std::max<size_t>(1, std::min(parts, num_segments));
+    }
+
+public:
+    explicit WorkStealingScheduler(size_t num_workers = std::thread::hardware_concurrency(),
+                                   SchedulerPolicy policy = SchedulerPolicy())
+        : m_policy(policy) {
+        num_workers = std::max<size_t>(num_workers, 1);
+        for (size_t w = 0; w < num_workers; w++) {
+            m_workers.push_back(std::make_unique<Worker>());
+        }
+        for (size_t w = 0; w < num_workers; w++) {
+            m_threads.emplace_back([this, w] { m_run(w); });
+        }
+    }
+
+    // Runs every task already submitted, then joins the workers
+    ~WorkStealingScheduler() {
+        {
+            std::lock_guard lock(m_idle_mutex);
+            m_stop = true;
+        }
+        m_idle_cv.notify_all();
+        for (auto& thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    WorkStealingScheduler(const WorkStealingScheduler&) = delete;
+    WorkStealingScheduler& operator=(const WorkStealingScheduler&) = delete;
+
+    size_t num_workers() const { return m_workers.size(); }
+
+    // Thread-safe; searches submitted after set_policy() returns use the new policy
+    SchedulerPolicy policy() const {
+        std::lock_guard lock(m_policy_mutex);
+        return m_policy;
+    }
+
+    void set_policy(const SchedulerPolicy& policy) {
+        std::lock_guard lock(m_policy_mutex);
+        m_policy = policy;
+    }
+
+    // Queues a task. From a worker it goes on that worker's own deque (LIFO
+    // for locality); from outside it is spread round-robin.
+    void submit(std::function<void()> task) {
+        size_t w;
+        if (m_worker_owner() == this) {
+            w = static_cast<size_t>(m_worker_index());
+        } else {
+            w = m_next_victim.fetch_add(1, std::memory_order_relaxed) % m_workers.size();
+        }
+        // Count the task before it becomes stealable, so the worker that runs
+        // it can never decrement m_pending below zero
+        {
+            std::lock_guard lock(m_idle_mutex);
+            m_pending.fetch_add(1, std::memory_order_relaxed);
+        }
+        {
+            std::lock_guard lock(m_workers[w]->mutex);
+            m_workers[w]->tasks.push_back(std::move(task));
+        }
+        m_idle_cv.notify_one();
+    }
+
+    // Top-k search split into segment-stripe tasks according to the policy.
+    // All stripes share one store snapshot. Before each segment a stripe calls
+    // stop() (possibly from several workers at once); once it returns true the
+    // remaining segments are skipped. The
+    // last stripe to finish merges the partial results and calls
+    // done(neighbors, completed) on its worker, so no worker ever blocks on
+    // another; completed is false when stop() cut the scan short.
+    template <typename fpT, typename qT, typename Stop, typename Done>
+    void search_then(const HybridStore<fpT, qT>& store,
+                     const HybridVector<fpT, qT>& query,
+                     size_t k,
+                     const IdFilter& filter,
+                     Stop stop,
+                     Done done) {
+        using Snapshot = typename HybridStore<fpT, qT>::Snapshot;
+
+        struct State {
+            Snapshot snapshot;
+            HybridVector<fpT, qT> query;
+            IdFilter filter;
+            Stop stop;
+            Done done;
+            std::vector<TopK<fpT>> partial;
+            std::atomic<size_t> remaining;
+            std::atomic<bool> stopped{false};
+
+            State(Snapshot snap, const HybridVector<fpT, qT>& q, const IdFilter& f,
+                  Stop st, Done d, size_t parts, size_t k)
+                : snapshot(std::move(snap)), query(q), filter(f), stop(std::move(st)), done(std::move(d)),
+                  partial(parts, TopK<fpT>(k)), remaining(parts) {}
+        };
+
+        Snapshot snapshot = store.snapshot();
+        // Reserved slots bound the row count without a pass over the segments
+        const size_t parts = m_num_parts(snapshot.num_rows(), k, snapshot.num_segments());
+        auto state = std::make_shared<State>(std::move(snapshot), query, filter,
+                                             std::move(stop), std::move(done), parts, k);
+
+        for (size_t part = 0; part < parts; part++) {
+            submit([state, part, parts, k] {
+                auto& top = state->partial[part];
+                for (size_t i = part; i < state->snapshot.num_segments(); i += parts) {
+                    if (state->stopped.load(std::memory_order_relaxed) || state->stop()) {
+                        state->stopped.store(true, std::memory_order_relaxed);
+                        break;
+                    }
+                    state->snapshot.scan_segment_blocks(i, state->query, state->filter,
+                                                        [&](const size_t* ids, const fpT* distances, size_t n) {
+                                                            top.push_block(ids, distances, n);
+                                                        });
+                }
+
+                if (state->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    TopK<fpT> merged(k);
+                    for (const auto& partial : state->partial) {
+                        merged.merge(partial);
+                    }
+                    state->done(merged.take_sorted(), !state->stopped.load(std::memory_order_relaxed));
+                }
+            });
+        }
+    }
+
+    // search_then() delivering the neighbours through a future
+    template <typename fpT, typename qT>
+    std::future<std::vector<Neighbor<fpT>>> search(const HybridStore<fpT, qT>& store,
+                                                   const HybridVector<fpT, qT>& query,
+                                                   size_t k,
+                                                   const IdFilter& filter = IdFilter()) {
+        auto promise = std::make_shared<std::promise<std::vector<Neighbor<fpT>>>>();
+        auto future = promise->get_future();
+        search_then(store, query, k, filter,
+                    [] { return false; },
+                    [promise](std::vector<Neighbor<fpT>> neighbors, bool) {
+                        promise->set_value(std::move(neighbors));
+                    });
+        return future;
+    }
+
+    // Waits for future while running queued tasks on the calling worker, so
+    // nested searches issued from inside a task cannot deadlock the pool
+    template <typename T>
+    T wait(std::future<T>& future) {
+        if (m_worker_owner() == this) {
+            size_t w = static_cast<size_t>(m_worker_index());
+            while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                if (!m_try_run_one(w)) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+        return future.get();
+    }
+};
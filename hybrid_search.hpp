@@ -0,0 +1,488 @@
+#pragma once
+
+#include "hybrid_vector.hpp"
+#include "hybrid_pool.hpp"
+#include <functional>
+#include <utility>
+
+// Result of a search: row id within the collection and squared distance to the query
+template <typename fpT>
+struct Neighbor {
+    size_t id;
+    fpT distance;
+};
+
+// Software prefetch settings for scans. While a row is scored, the fp and q
+// halves of the row prefetch_distance scored rows later are requested, so
+// the next rows' cache misses overlap with the current distance computation;
+// rows a filter or tombstone rejects are never prefetched. 0 disables it,
+// and distances above PrefetchQueue::max_distance are capped.
+// Streaming scans use the non-temporal hint, which keeps a one-shot pass from
+// evicting hot data (index structures, other queries' rows) from the caches.
+//
+// threads splits a single query's scan over that many pool threads, each
+// with its own top-k, merged at the end; 1 scans on the calling thread and
+// auto_threads lets scan_threads() choose.
+constexpr size_t auto_threads = 0;
+
+struct ScanHints {
+    size_t prefetch_distance = 4;
+    bool streaming = false;
+    size_t threads = 1;
+    size_t min_rows_per_thread = 32768;  // auto_threads: smallest share worth a thread
+};
+
+// Requests every cache line of [data, data + bytes) for reading
+inline void prefetch_range(const void* data, size_t bytes, bool streaming) {
+    const char* p = static_cast<const char*>(data);
+    if (streaming) {
+        for (size_t offset = 0; offset < bytes; offset += 64) {
+            __builtin_prefetch(p + offset, 0, 0);
+        }
+    } else {
+        for (size_t offset = 0; offset < bytes; offset += 64) {
+            __builtin_prefetch(p + offset, 0, 3);
+        }
+    }
+}
+
+// Delays the rows a scan will score by distance positions, so the caller
+// can prefetch each row as it is found and score it distance rows later.
+// Only rows that will be scored pass through, so none is prefetched in vain.
+class PrefetchQueue {
+public:
+    static constexpr size_t max_distance = 64;
+
+private:
+    size_t m_items[max_distance];
+    size_t m_distance;
+    size_t m_head = 0;
+    size_t m_count = 0;
+
+public:
+    explicit PrefetchQueue(size_t distance) : m_distance(std::min(distance, max_distance)) {}
+
+    // Adds item. Returns true and sets ready to the item now distance
+    // positions old (item itself when the distance is 0).
+    bool push(size_t item, size_t& ready) {
+        if (m_count < m_distance) {
+            size_t tail = m_head + m_count;
+            m_items[tail < m_distance ? tail : tail - m_distance] = item;
+            m_count++;
+            return false;
+        }
+        if (m_distance == 0) {
+            ready = item;
+            return true;
+        }
+        ready = m_items[m_head];
+        m_items[m_head] = item;
+        if (++m_head == m_distance) {
+            m_head = 0;
+        }
+        return true;
+    }
+
+    // Takes the oldest remaining item; false when empty
+    bool pop(size_t& ready) {
+        if (m_count == 0) {
+            return false;
+        }
+        ready = m_items[m_head];
+        if (++m_head == m_distance) {
+            m_head = 0;
+        }
+        m_count--;
+        return true;
+    }
+};
+
+// Plain bitset of allowed row ids, one bit per row packed into 64-bit words
+class IdBitset {
+private:
+    size_t m_size;
+    std::vector<u64> m_words;
+
+public:
+    explicit IdBitset(size_t size, bool value = false)
+        : m_size(size), m_words((size + 63) / 64, value ? ~u64(0) : u64(0)) {
+        // Keep the bits past m_size clear so whole-word scans never see them
+        if (value && (size % 64) != 0) {
+            m_words.back() = (u64(1) << (size % 64)) - 1;
+        }
+    }
+
+    void set(size_t id) {
+        assert(id < m_size);
+        m_words[id / 64] |= u64(1) << (id % 64);
+    }
+
+    void reset(size_t id) {
+        assert(id < m_size);
+        m_words[id / 64] &= ~(u64(1) << (id % 64));
+    }
+
+    bool test(size_t id) const {
+        return id < m_size && (m_words[id / 64] >> (id % 64)) & 1;
+    }
+
+    size_t count() const {
+        size_t total = 0;
+        for (u64 w : m_words) {
+            total += __builtin_popcountll(w);
+        }
+        return total;
+    }
+
+    size_t size() const { return m_size; }
+    size_t num_words() const { return m_words.size(); }
+    u64 word(size_t w) const { return w < m_words.size() ? m_words[w] : 0; }
+};
+
+// Metadata filter pushed down into the scan. Either a bitset of allowed ids,
+// a predicate callback, or both (a row must pass both). Default allows all.
+class IdFilter {
+private:
+    const IdBitset* m_bitset = nullptr;
+    std::function<bool(size_t)> m_predicate;
+
+public:
+    IdFilter() = default;
+
+    IdFilter(const IdBitset& bitset) : m_bitset(&bitset) {}
+
+    IdFilter(std::function<bool(size_t)> predicate) : m_predicate(std::move(predicate)) {}
+
+    IdFilter(const IdBitset& bitset, std::function<bool(size_t)> predicate)
+        : m_bitset(&bitset), m_predicate(std::move(predicate)) {}
+
+    bool empty() const { return m_bitset == nullptr && !m_predicate; }
+
+    bool allows(size_t id) const {
+        if (m_bitset != nullptr && !m_bitset->test(id)) {
+            return false;
+        }
+        return !m_predicate || m_predicate(id);
+    }
+
+    // Mask of candidate ids in [64 * w, 64 * w + 64) before the predicate is applied
+    u64 word_mask(size_t w) const {
+        return m_bitset != nullptr ? m_bitset->word(w) : ~u64(0);
+    }
+
+    // Calls fn(id) for every allowed id in [begin, end). Bitset words that are
+    // zero skip 64 rows at a time, so rejected rows are never touched.
+    template <typename Fn>
+    void for_each_allowed(size_t begin, size_t end, Fn&& fn) const {
+        if (empty()) {
+            for (size_t id = begin; id < end; id++) {
+                fn(id);
+            }
+            return;
+        }
+
+        for (size_t w = begin / 64; w * 64 < end; w++) {
+            u64 mask = word_mask(w);
+            size_t base = w * 64;
+            if (base < begin) {
+                mask &= ~u64(0) << (begin - base);
+            }
+            if (end - base < 64) {
+                mask &= (u64(1) << (end - base)) - 1;
+            }
+
+            while (mask != 0) {
+                size_t id = base + __builtin_ctzll(mask);
+                mask &= mask - 1;
+                if (!m_predicate || m_predicate(id)) {
+                    fn(id);
+                }
+            }
+        }
+    }
+};
+
+// Keeps the k nearest candidates seen so far. Candidates that beat the
+// current threshold are appended to a buffer of about 2k entries; when it
+// fills, a partial sort (nth_element) keeps the best k and tightens the
+// threshold. push_block() tests a whole block of distances against the
+// threshold with SIMD and compacts the survivors branch-free, so once the
+// threshold is tight most blocks cost one vector compare pass.
+template <typename fpT>
+class TopK {
+private:
+    static constexpr size_t block_size = 64;
+
+    size_t m_k = 0;
+    size_t m_capacity = 0;
+    size_t m_count = 0;
+    fpT m_threshold = std::numeric_limits<fpT>::max();
+    // m_capacity candidate slots plus block_size slack for compaction
+    std::vector<Neighbor<fpT>> m_buffer;
+
+    static bool m_less(const Neighbor<fpT>& a, const Neighbor<fpT>& b) {
+        return a.distance < b.distance;
+    }
+
+    // Keeps only the best k candidates; the k-th becomes the threshold
+    void m_prune() {
+        if (m_count <= m_k) {
+            return;
+        }
+        std::nth_element(m_buffer.begin(), m_buffer.begin() + (m_k - 1), m_buffer.begin() + m_count, m_less);
+        m_count = m_k;
+        m_threshold = m_buffer[m_k - 1].distance;
+    }
+
+public:
+    explicit TopK(size_t k = 0) {
+        reset(k);
+    }
+
+    // Empties the selector for reuse with a new k, keeping its allocation
+    void reset(size_t k) {
+        m_k = k;
+        m_capacity = 2 * k + block_size;
+        m_count = 0;
+        m_threshold = std::numeric_limits<fpT>::max();
+        m_buffer.resize(m_capacity + block_size);
+    }
+
+    // Distance a candidate must beat to be kept. Until the buffer is next
+    // pruned it can be looser than the current k-th best distance.
+    fpT threshold() const {
+        return m_threshold;
+    }
+
+    void push(size_t id, fpT distance) {
+        if (m_k == 0 || !(distance < m_threshold)) {
+            return;
+        }
+        m_buffer[m_count++] = {id, distance};
+        if (m_count >= m_capacity) {
+            m_prune();
+        }
+    }
+
+    // Offers n candidates at once: ids[j] at squared distance distances[j]
+    void push_block(const size_t* ids, const fpT* distances, size_t n) {
+        if (m_k == 0) {
+            return;
+        }
+        for (size_t begin = 0; begin < n; begin += block_size) {
+            const size_t end = std::min(begin + block_size, n);
+            const fpT threshold = m_threshold;
+
+            size_t hits = 0;
+#pragma omp simd reduction(+:hits)
+            for (size_t j = begin; j < end; j++) {
+                hits += distances[j] < threshold;
+            }
+            if (hits == 0) {
+                continue;
+            }
+
+            // Every row is written, only survivors advance the cursor
+            Neighbor<fpT>* out = m_buffer.data();
+            size_t count = m_count;
+            for (size_t j = begin; j < end; j++) {
+                out[count] = {ids[j], distances[j]};
+                count += distances[j] < threshold;
+            }
+            m_count = count;
+            if (m_count >= m_capacity) {
+                m_prune();
+            }
+        }
+    }
+
+    void merge(const TopK& other) {
+        for (size_t i = 0; i < other.m_count; i++) {
+            push(other.m_buffer[i].id, other.m_buffer[i].distance);
+        }
+    }
+
+    size_t size() const { return std::min(m_count, m_k); }
+
+    // Results ordered by ascending distance; leaves the selector empty
+    std::vector<Neighbor<fpT>> take_sorted() {
+        m_prune();
+        std::vector<Neighbor<fpT>> result(m_buffer.begin(), m_buffer.begin() + m_count);
+        std::sort(result.begin(), result.end(), m_less);
+        m_count = 0;
+        m_threshold = std::numeric_limits<fpT>::max();
+        return result;
+    }
+};
+
+// Number of threads to split a scan over rows rows across. A scan issued
+// from inside a job of the same pool always stays on the calling thread,
+// since the pool cannot run a nested job. Explicit hints are capped at the
+// pool size. In auto mode the scan also stays serial when it is small or the
+// pool is already busy with another query; otherwise it takes one thread per
+// min_rows_per_thread rows, up to pool.idle_cpus().
+inline size_t scan_threads(const ScanHints& hints, size_t rows, const WorkerPool& pool) {
+    if (pool.on_pool_thread()) {
+        return 1;
+    }
+    if (hints.threads != auto_threads) {
+        return std::min(hints.threads, pool.num_threads());
+    }
+    const size_t min_rows = std::max<size_t>(hints.min_rows_per_thread, 1);
+    if (rows < 2 * min_rows || pool.busy()) {
+        return 1;
+    }
+    return std::max<size_t>(1, std::min({pool.num_threads(), rows / min_rows, pool.idle_cpus()}));
+}
+
+// Calls visit(id, squared_distance) for every row in [begin, end) allowed by
+// the filter, in id order. Filtering happens before the distance kernel, so
+// rejected rows never have their fp/q halves loaded, not even by prefetch:
+// each allowed row's halves (separate heap blocks) are prefetched when the
+// filter yields it and scored hints.prefetch_distance allowed rows later.
+template <typename fpT, typename qT, typename Fn>
+void scan_range(const std::vector<HybridVector<fpT, qT>>& collection,
+                const HybridVector<fpT, qT>& query,
+                const IdFilter& filter,
+                size_t begin,
+                size_t end,
+                Fn&& visit,
+                const ScanHints& hints = ScanHints()) {
+    PrefetchQueue pending(hints.prefetch_distance);
+    size_t ready;
+    filter.for_each_allowed(begin, end, [&](size_t id) {
+        if (hints.prefetch_distance != 0) {
+            const HybridVector<fpT, qT>& row = collection[id];
+            prefetch_range(row.fp_half(), row.half_size() * sizeof(fpT), hints.streaming);
+            prefetch_range(row.q_half(), row.half_size() * sizeof(qT), hints.streaming);
+        }
+        if (pending.push(id, ready)) {
+            visit(ready, query.squared_distance_to(collection[ready]));
+        }
+    });
+    while (pending.pop(ready)) {
+        visit(ready, query.squared_distance_to(collection[ready]));
+    }
+}
+
+// scan_range() over the whole collection
+template <typename fpT, typename qT, typename Fn>
+void scan(const std::vector<HybridVector<fpT, qT>>& collection,
+          const HybridVector<fpT, qT>& query,
+          const IdFilter& filter,
+          Fn&& visit,
+          const ScanHints& hints = ScanHints()) {
+    scan_range(collection, query, filter, 0, collection.size(), visit, hints);
+}
+
+// Offers the rows in [begin, end) allowed by the filter to top, in blocks
+template <typename fpT, typename qT>
+void scan_top_k(const std::vector<HybridVector<fpT, qT>>& collection,
+                const HybridVector<fpT, qT>& query,
+                const IdFilter& filter,
+                size_t begin,
+                size_t end,
+                TopK<fpT>& top,
+                const ScanHints& hints = ScanHints()) {
+    size_t ids[64];
+    fpT distances[64];
+    size_t n = 0;
+    scan_range(collection, query, filter, begin, end, [&](size_t id, fpT distance) {
+        ids[n] = id;
+        distances[n] = distance;
+        if (++n == 64) {
+            top.push_block(ids, distances, n);
+            n = 0;
+        }
+    }, hints);
+    top.push_block(ids, distances, n);
+}
+
+// Exact k-nearest-neighbour search over the rows allowed by the filter.
+// With hints.threads != 1 the scan is split into contiguous id ranges over
+// pool threads (see scan_threads); a filter predicate must then be thread-safe.
+template <typename fpT, typename qT>
+std::vector<Neighbor<fpT>> search(const std::vector<HybridVector<fpT, qT>>& collection,
+                                  const HybridVector<fpT, qT>& query,
+                                  size_t k,
+                                  const IdFilter& filter = IdFilter(),
+                                  const ScanHints& hints = ScanHints(),
+                                  WorkerPool& pool = default_worker_pool()) {
+    const size_t n = collection.size();
+    const size_t threads = hints.threads == 1 ? 1 : scan_threads(hints, n, pool);
+
+    TopK<fpT> top(k);
+    if (threads <= 1) {
+        scan_top_k(collection, query, filter, 0, n, top, hints);
+        return top.take_sorted();
+    }
+
+    // Partials live in pool scratch; hold the pool until they are merged
+    auto lease = pool.lease();
+    pool.run([&](size_t t) {
+        auto& partial = pool.scratch(t).get<TopK<fpT>>();
+        partial.reset(k);
+        scan_top_k(collection, query, filter, n * t / threads, n * (t + 1) / threads, partial, hints);
+    }, threads);
+    for (size_t t = 0; t < threads; t++) {
+        top.merge(pool.scratch(t).get<TopK<fpT>>());
+    }
+    return top.take_sorted();
+}
+
+// All rows allowed by the filter whose squared distance to the query is
+// <= squared_radius (the radius squared, as distances are never rooted),
+// ordered by id. Each pool thread scans a contiguous id range into its own
+// scratch buffer with early-abandon distances; buffers are then copied to
+// precomputed offsets, so threads need no locking. The pool is held
+// throughout. Called from inside a job of the same pool, the scan runs
+// serially on the calling thread instead. A filter predicate is called
+// concurrently and must be thread-safe.
+template <typename fpT, typename qT>
+std::vector<Neighbor<fpT>> range_search(const std::vector<HybridVector<fpT, qT>>& collection,
+                                        const HybridVector<fpT, qT>& query,
+                                        fpT squared_radius,
+                                        const IdFilter& filter = IdFilter(),
+                                        WorkerPool& pool = default_worker_pool()) {
+    using Buffer = std::vector<Neighbor<fpT>>;
+
+    const size_t n = collection.size();
+    auto scan_into = [&](size_t begin, size_t end, Buffer& out) {
+        filter.for_each_allowed(begin, end, [&](size_t id) {
+            fpT distance = query.squared_distance_to(collection[id], squared_radius);
+            if (distance <= squared_radius) {
+                out.push_back({id, distance});
+            }
+        });
+    };
+
+    // run() and lease() would wait on the job this thread belongs to
+    if (pool.on_pool_thread()) {
+        Buffer result;
+        scan_into(0, n, result);
+        return result;
+    }
+
+    const size_t num_threads = pool.num_threads();
+    std::vector<size_t> offsets(num_threads + 1, 0);
+
+    // Both passes and the sizing between them read scratch buffers
+    auto lease = pool.lease();
+    pool.run([&](size_t t) {
+        Buffer& local = pool.scratch(t).get<Buffer>();
+        local.clear();
+        scan_into(n * t / num_threads, n * (t + 1) / num_threads, local);
+    });
+
+    for (size_t t = 0; t < num_threads; t++) {
+        offsets[t + 1] = offsets[t] + pool.scratch(t).get<Buffer>().size();
+    }
+    std::vector<Neighbor<fpT>> result(offsets[num_threads]);
+
+    pool.run([&](size_t t) {
+        const Buffer& local = pool.scratch(t).get<Buffer>();
+        std::copy(local.begin(), local.end(), result.begin() + offsets[t]);
+    });
+
+    return result;
+}
@@ -0,0 +1,721 @@
+#pragma once
+
+#include "hybrid_search.hpp"
+#include "hybrid_memory.hpp"
+#include "hybrid_epoch.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Fixed-capacity block of rows stored contiguously: fp halves, q halves and
+// per-row scale side by side, optionally placed on one NUMA node and backed
+// by huge pages. A segment created with keep_stats also holds
+// HybridVectorStats for rows inserted with them, in the same kind of memory.
+// Appenders claim slots with an atomic counter and publish each row through
+// a ready bitmap; deletes set a tombstone bit.
+template <typename fpT, typename qT>
+class HybridSegment {
+private:
+    size_t m_capacity;
+    size_t m_half_size;
+    u64 m_first_id;
+
+    MappedArray<fpT> m_fp;
+    MappedArray<qT> m_q;
+    std::vector<fpT> m_scale;
+    // Empty unless the segment keeps stats
+    MappedArray<HybridVectorStats<fpT>> m_stats;
+    std::vector<u64> m_ids;
+
+    std::atomic<size_t> m_reserved{0};
+    std::unique_ptr<std::atomic<u64>[]> m_ready;
+    std::unique_ptr<std::atomic<u64>[]> m_tombstones;
+    // Slots whose m_stats entry is valid; set before the ready bit. Null
+    // unless the segment keeps stats.
+    std::unique_ptr<std::atomic<u64>[]> m_has_stats;
+    std::atomic<size_t> m_num_deleted{0};
+
+public:
+    // Fresh segment whose slots carry ids first_id, first_id + id_stride, ...
+    HybridSegment(size_t capacity, size_t half_size, u64 first_id, u64 id_stride = 1, int numa_node = -1,
+                  PageSize pages = PageSize::huge_2m, bool keep_stats = false)
+        : m_capacity(capacity),
+          m_half_size(half_size),
+          m_first_id(first_id),
+          m_fp(capacity * half_size, numa_node, pages),
+          m_q(capacity * half_size, numa_node, pages),
+          m_scale(capacity),
+          m_stats(keep_stats ? capacity : 0, numa_node, pages),
+          m_ids(capacity),
+          m_ready(new std::atomic<u64>[(capacity + 63) / 64]),
+          m_tombstones(new std::atomic<u64>[(capacity + 63) / 64]),
+          m_has_stats(keep_stats ? new std::atomic<u64>[(capacity + 63) / 64] : nullptr) {
+        for (size_t w = 0; w < num_words(); w++) {
+            m_ready[w].store(0, std::memory_order_relaxed);
+            m_tombstones[w].store(0, std::memory_order_relaxed);
+            if (m_has_stats) {
+                m_has_stats[w].store(0, std::memory_order_relaxed);
+            }
+        }
+        for (size_t slot = 0; slot < capacity; slot++) {
+            m_ids[slot] = first_id + slot * id_stride;
+        }
+    }
+
+    size_t capacity() const { return m_capacity; }
+    size_t num_words() const { return (m_capacity + 63) / 64; }
+
+    // Number of slots handed out so far (some may still be being written)
+    size_t num_reserved() const {
+        return std::min(m_reserved.load(std::memory_order_acquire), m_capacity);
+    }
+
+    size_t num_deleted() const { return m_num_deleted.load(std::memory_order_relaxed); }
+    bool full() const { return m_reserved.load(std::memory_order_relaxed) >= m_capacity; }
+
+    u64 id(size_t slot) const { return m_ids[slot]; }
+    // Lower bound on every id in the segment
+    u64 first_id() const { return m_first_id; }
+    const fpT* fp(size_t slot) const { return m_fp.data() + slot * m_half_size; }
+    const qT* q(size_t slot) const { return m_q.data() + slot * m_half_size; }
+    fpT scale(size_t slot) const { return m_scale[slot]; }
+    bool keeps_stats() const { return m_has_stats != nullptr; }
+    // Whether the row was written with HybridVectorStats; valid once published
+    bool has_stats(size_t slot) const {
+        return m_has_stats && (m_has_stats[slot / 64].load(std::memory_order_relaxed) >> (slot % 64)) & 1;
+    }
+    const HybridVectorStats<fpT>& stats(size_t slot) const {
+        assert(has_stats(slot));
+        return m_stats[slot];
+    }
+    PageSize fp_page_size() const { return m_fp.page_size(); }
+    PageSize q_page_size() const { return m_q.page_size(); }
+
+    // Software prefetch of a slot's fp and q halves
+    void prefetch(size_t slot, bool streaming) const {
+        prefetch_range(fp(slot), m_half_size * sizeof(fpT), streaming);
+        prefetch_range(q(slot), m_half_size * sizeof(qT), streaming);
+    }
+
+    // Claims a slot; returns capacity() when the segment is full
+    size_t reserve() {
+        size_t slot = m_reserved.fetch_add(1, std::memory_order_relaxed);
+        return slot < m_capacity ? slot : m_capacity;
+    }
+
+    // Overrides the id of a slot; only valid before the segment is shared
+    void assign_id(size_t slot, u64 id) {
+        m_ids[slot] = id;
+    }
+
+    // Copies a row, and its stats unless null or the segment does not keep
+    // them, into a reserved slot and makes it visible to readers
+    void write(size_t slot, const fpT* fp, const qT* q, fpT scale,
+               const HybridVectorStats<fpT>* stats = nullptr) {
+        std::copy(fp, fp + m_half_size, m_fp.data() + slot * m_half_size);
+        std::copy(q, q + m_half_size, m_q.data() + slot * m_half_size);
+        m_scale[slot] = scale;
+        if (stats != nullptr && keeps_stats()) {
+            m_stats[slot] = *stats;
+            m_has_stats[slot / 64].fetch_or(u64(1) << (slot % 64), std::memory_order_relaxed);
+        }
+        m_ready[slot / 64].fetch_or(u64(1) << (slot % 64), std::memory_order_release);
+    }
+
+    // Slot holding id, or capacity() when absent. Ids are sorted within a segment.
+    size_t find(u64 id) const {
+        auto end = m_ids.begin() + num_reserved();
+        auto it = std::lower_bound(m_ids.begin(), end, id);
+        return (it != end && *it == id) ? static_cast<size_t>(it - m_ids.begin()) : m_capacity;
+    }
+
+    // Returns false when the row was not live (unpublished or already deleted)
+    bool erase(size_t slot) {
+        u64 bit = u64(1) << (slot % 64);
+        if ((m_ready[slot / 64].load(std::memory_order_acquire) & bit) == 0) {
+            return false;
+        }
+        u64 prev = m_tombstones[slot / 64].fetch_or(bit, std::memory_order_acq_rel);
+        if (prev & bit) {
+            return false;
+        }
+        m_num_deleted.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool deleted(size_t slot) const {
+        return (m_tombstones[slot / 64].load(std::memory_order_acquire) >> (slot % 64)) & 1;
+    }
+
+    // Published, non-deleted slots in [64 * w, 64 * w + 64)
+    u64 live_mask(size_t w) const {
+        return m_ready[w].load(std::memory_order_acquire) &
+               ~m_tombstones[w].load(std::memory_order_acquire);
+    }
+
+    size_t num_live() const {
+        size_t total = 0;
+        for (size_t w = 0; w < num_words(); w++) {
+            total += __builtin_popcountll(live_mask(w));
+        }
+        return total;
+    }
+};
+
+// Mutable collection of HybridVectors. Rows are appended concurrently into
+// fixed-size segments, deleted by tombstone and physically removed by
+// compaction, which may run on a background thread. Row ids are assigned in
+// insertion order (id_base, id_base + id_stride, ...) and never reused.
+//
+// Readers never lock: they pin an epoch and load the current segment
+// directory, an immutable array swapped atomically whenever a segment is
+// added or rewritten. Rows never move while a reader is pinned, and replaced
+// directories and segments are freed through epoch-based reclamation once
+// no pinned reader can still reach them.
+template <typename fpT, typename qT>
+class HybridStore {
+private:
+    using Segment = HybridSegment<fpT, qT>;
+
+    // Segments ordered by id; only the last one accepts appends
+    struct Directory {
+        std::vector<Segment*> segments;
+    };
+
+    size_t m_half_size;
+    size_t m_segment_capacity;
+    int m_numa_node;
+    u64 m_id_stride;
+    PageSize m_page_size;
+    bool m_keep_stats;
+
+    std::atomic<size_t> m_prefetch_distance{ScanHints().prefetch_distance};
+    std::atomic<bool> m_streaming{ScanHints().streaming};
+    std::atomic<size_t> m_scan_threads{ScanHints().threads};
+    std::atomic<size_t> m_min_rows_per_thread{ScanHints().min_rows_per_thread};
+
+    std::atomic<Directory*> m_directory;
+    mutable EpochManager m_epochs;
+    // Serialise directory writers (segment rollover, compaction) only
+    std::mutex m_writer_mutex;
+    std::mutex m_compaction_mutex;
+    u64 m_next_first_id;
+
+    std::thread m_compactor;
+    std::mutex m_compactor_mutex;
+    std::condition_variable m_compactor_cv;
+    bool m_compactor_stop = false;
+
+    Segment* m_new_segment() {
+        Segment* seg = new Segment(m_segment_capacity, m_half_size, m_next_first_id, m_id_stride, m_numa_node,
+                                   m_page_size, m_keep_stats);
+        m_next_first_id += m_segment_capacity * m_id_stride;
+        return seg;
+    }
+
+    const Directory& m_load() const {
+        return *m_directory.load(std::memory_order_seq_cst);
+    }
+
+    // Swaps in a new directory and retires the old one; caller holds m_writer_mutex
+    void m_publish(Directory* next) {
+        Directory* prev = m_directory.exchange(next, std::memory_order_seq_cst);
+        m_epochs.retire([prev] { delete prev; });
+    }
+
+    // Segment that may hold id, or nullptr; caller is pinned
+    static Segment* m_segment_for(const Directory& dir, u64 id) {
+        auto it = std::upper_bound(dir.segments.begin(), dir.segments.end(), id,
+                                   [](u64 value, const Segment* seg) {
+                                       return value < seg->first_id();
+                                   });
+        return it == dir.segments.begin() ? nullptr : *(it - 1);
+    }
+
+    // Copies the live rows of a sealed segment into a tightly sized one. A
+    // segment is sealed once it is full and every reserved slot is published
+    // (see compact); only tombstones change it after that.
+    Segment* m_rewrite(const Segment& seg) const {
+        Segment* compacted = new Segment(std::max<size_t>(seg.num_live(), 1), m_half_size, seg.first_id(),
+                                         m_id_stride, m_numa_node, m_page_size, m_keep_stats);
+        for (size_t w = 0; w < seg.num_words(); w++) {
+            u64 mask = seg.live_mask(w);
+            while (mask != 0) {
+                size_t slot = w * 64 + __builtin_ctzll(mask);
+                mask &= mask - 1;
+                size_t dst = compacted->reserve();
+                assert(dst < compacted->capacity() && "segment changed while being rewritten");
+                compacted->assign_id(dst, seg.id(slot));
+                compacted->write(dst, seg.fp(slot), seg.q(slot), seg.scale(slot),
+                                 seg.has_stats(slot) ? &seg.stats(slot) : nullptr);
+            }
+        }
+        return compacted;
+    }
+
+public:
+    // pages is the requested page size for segment memory; see PageSize.
+    // With keep_stats, rows inserted with HybridVectorStats keep them.
+    HybridStore(size_t half_size, size_t segment_capacity = 4096, int numa_node = -1,
+                u64 id_base = 0, u64 id_stride = 1, PageSize pages = PageSize::huge_2m,
+                bool keep_stats = false)
+        : m_half_size(half_size),
+          m_segment_capacity(segment_capacity),
+          m_numa_node(numa_node),
+          m_id_stride(id_stride),
+          m_page_size(pages),
+          m_keep_stats(keep_stats),
+          m_next_first_id(id_base) {
+        assert(segment_capacity > 0);
+        m_directory.store(new Directory{{m_new_segment()}});
+    }
+
+    ~HybridStore() {
+        stop_compaction();
+        Directory* dir = m_directory.load();
+        for (Segment* seg : dir->segments) {
+            delete seg;
+        }
+        delete dir;
+    }
+
+    HybridStore(const HybridStore&) = delete;
+    HybridStore& operator=(const HybridStore&) = delete;
+
+    size_t half_size() const { return m_half_size; }
+    int numa_node() const { return m_numa_node; }
+
+    // Page size obtained for the fp halves of the oldest segment
+    PageSize page_size() const {
+        auto guard = m_epochs.pin();
+        return m_load().segments.front()->fp_page_size();
+    }
+
+    // Prefetch and parallelism settings picked up by snapshots taken afterwards
+    void set_scan_hints(const ScanHints& hints) {
+        m_prefetch_distance.store(hints.prefetch_distance, std::memory_order_relaxed);
+        m_streaming.store(hints.streaming, std::memory_order_relaxed);
+        m_scan_threads.store(hints.threads, std::memory_order_relaxed);
+        m_min_rows_per_thread.store(hints.min_rows_per_thread, std::memory_order_relaxed);
+    }
+
+    ScanHints scan_hints() const {
+        return ScanHints{m_prefetch_distance.load(std::memory_order_relaxed),
+                         m_streaming.load(std::memory_order_relaxed),
+                         m_scan_threads.load(std::memory_order_relaxed),
+                         m_min_rows_per_thread.load(std::memory_order_relaxed)};
+    }
+
+    size_t num_segments() const {
+        auto guard = m_epochs.pin();
+        return m_load().segments.size();
+    }
+
+    // Number of live (published, non-deleted) rows
+    size_t size() const {
+        auto guard = m_epochs.pin();
+        size_t total = 0;
+        for (const Segment* seg : m_load().segments) {
+            total += seg->num_live();
+        }
+        return total;
+    }
+
+    // Thread-safe and lock-free unless the active segment is full; returns
+    // the id assigned to the new row. The row keeps vec's HybridVectorStats
+    // if it has them and the store keeps stats.
+    u64 insert(const HybridVector<fpT, qT>& vec) {
+        assert(vec.half_size() == m_half_size);
+
+        for (;;) {
+            {
+                auto guard = m_epochs.pin();
+                Segment& seg = *m_load().segments.back();
+                size_t slot = seg.reserve();
+                if (slot < seg.capacity()) {
+                    seg.write(slot, vec.fp_half(), vec.q_half(), vec.scale(),
+                              vec.has_stats() ? &vec.stats() : nullptr);
+                    return seg.id(slot);
+                }
+            }
+
+            std::lock_guard lock(m_writer_mutex);
+            const Directory& dir = m_load();
+            if (dir.segments.back()->full()) {
+                Directory* next = new Directory(dir);
+                next->segments.push_back(m_new_segment());
+                m_publish(next);
+            }
+        }
+    }
+
+    // Quantizes and inserts rows on the pool threads; returns the ids in row
+    // order. Rows land in the store in no particular order. Called from
+    // inside a job of the same pool, the rows are inserted serially on the
+    // calling thread instead.
+    std::vector<u64> insert_batch(const std::vector<std::vector<fpT>>& rows,
+                                  WorkerPool& pool = default_worker_pool()) {
+        std::vector<u64> ids(rows.size());
+        // parallel_for() would wait on the job this thread belongs to
+        if (pool.on_pool_thread()) {
+            for (size_t i = 0; i < rows.size(); i++) {
+                ids[i] = insert(HybridVector<fpT, qT>(rows[i]));
+            }
+            return ids;
+        }
+        pool.parallel_for(rows.size(), [&](size_t i, size_t) {
+            ids[i] = insert(HybridVector<fpT, qT>(rows[i]));
+        }, 64);
+        return ids;
+    }
+
+    // Thread-safe; returns false when id is unknown or already deleted
+    bool erase(u64 id) {
+        auto guard = m_epochs.pin();
+        Segment* seg = m_segment_for(m_load(), id);
+        if (seg == nullptr) {
+            return false;
+        }
+        size_t slot = seg->find(id);
+        return slot < seg->capacity() && seg->erase(slot);
+    }
+
+    bool contains(u64 id) const {
+        auto guard = m_epochs.pin();
+        const Segment* seg = m_segment_for(m_load(), id);
+        if (seg == nullptr) {
+            return false;
+        }
+        size_t slot = seg->find(id);
+        return slot < seg->capacity() && (seg->live_mask(slot / 64) >> (slot % 64)) & 1;
+    }
+
+    // Consistent view of the segment directory. Every segment in it stays
+    // alive, and stripes scanned from different threads see the same segment
+    // list, for as long as the snapshot exists. Rows appended or deleted after
+    // the snapshot was taken may or may not be visited.
+    class Snapshot {
+    private:
+        EpochManager::Guard m_guard;
+        const Directory* m_directory;
+        size_t m_half_size;
+        ScanHints m_hints;
+
+    public:
+        Snapshot(EpochManager::Guard guard, const Directory* directory, size_t half_size,
+                 const ScanHints& hints = ScanHints())
+            : m_guard(std::move(guard)), m_directory(directory), m_half_size(half_size), m_hints(hints) {}
+
+        size_t num_segments() const { return m_directory->segments.size(); }
+        const ScanHints& hints() const { return m_hints; }
+
+        // Upper bound on the rows a scan visits (reserved slots, live or not)
+        size_t num_rows() const {
+            size_t total = 0;
+            for (const Segment* seg : m_directory->segments) {
+                total += seg->num_reserved();
+            }
+            return total;
+        }
+        void set_hints(const ScanHints& hints) { m_hints = hints; }
+
+        // Stats stored with a row a scan visited, for norm-based pruning or
+        // error bounds; nullptr when the row was inserted without them, the
+        // store does not keep stats or the row is no longer live
+        const HybridVectorStats<fpT>* stats(u64 id) const {
+            const Segment* seg = m_segment_for(*m_directory, id);
+            if (seg == nullptr) {
+                return nullptr;
+            }
+            size_t slot = seg->find(id);
+            if (slot == seg->capacity() || ((seg->live_mask(slot / 64) >> (slot % 64)) & 1) == 0) {
+                return nullptr;
+            }
+            return seg->has_stats(slot) ? &seg->stats(slot) : nullptr;
+        }
+
+        // Calls visit_block(ids, squared_distances, n) for the live rows of
+        // segment i allowed by the filter, in blocks of at most 64 rows, so
+        // consumers such as TopK::push_block can work on whole blocks.
+        // Tombstoned and filtered rows are skipped before the kernel and are
+        // never prefetched: each accepted slot is prefetched when found and
+        // scored prefetch_distance accepted slots later.
+        template <typename Fn>
+        void scan_segment_blocks(size_t i, const HybridVector<fpT, qT>& query, const IdFilter& filter,
+                                 Fn&& visit_block) const {
+            assert(query.half_size() == m_half_size);
+
+            const Segment* seg = m_directory->segments[i];
+            const size_t reserved = seg->num_reserved();
+            PrefetchQueue pending(m_hints.prefetch_distance);
+            size_t ids[64];
+            fpT distances[64];
+            size_t n = 0;
+            auto score = [&](size_t slot) {
+                ids[n] = seg->id(slot);
+                distances[n] = query.squared_distance_to(seg->fp(slot), seg->q(slot), seg->scale(slot));
+                if (++n == 64) {
+                    visit_block(ids, distances, n);
+                    n = 0;
+                }
+            };
+
+            size_t ready;
+            size_t words = (reserved + 63) / 64;
+            for (size_t w = 0; w < words; w++) {
+                u64 mask = seg->live_mask(w);
+                while (mask != 0) {
+                    size_t slot = w * 64 + __builtin_ctzll(mask);
+                    mask &= mask - 1;
+                    if (!filter.allows(seg->id(slot))) {
+                        continue;
+                    }
+                    if (m_hints.prefetch_distance != 0) {
+                        seg->prefetch(slot, m_hints.streaming);
+                    }
+                    if (pending.push(slot, ready)) {
+                        score(ready);
+                    }
+                }
+            }
+            while (pending.pop(ready)) {
+                score(ready);
+            }
+            if (n != 0) {
+                visit_block(ids, distances, n);
+            }
+        }
+
+        // Calls visit(id, squared_distance) for every live row of segment i
+        // allowed by the filter; see scan_segment_blocks
+        template <typename Fn>
+        void scan_segment(size_t i, const HybridVector<fpT, qT>& query, const IdFilter& filter, Fn&& visit) const {
+            scan_segment_blocks(i, query, filter, [&](const size_t* ids, const fpT* distances, size_t n) {
+                for (size_t j = 0; j < n; j++) {
+                    visit(ids[j], distances[j]);
+                }
+            });
+        }
+
+        // Segments are striped over num_parts callers; this call scans stripe part
+        template <typename Fn>
+        void scan(const HybridVector<fpT, qT>& query, const IdFilter& filter, Fn&& visit,
+                  size_t part = 0, size_t num_parts = 1) const {
+            assert(part < num_parts);
+            for (size_t i = part; i < num_segments(); i += num_parts) {
+                scan_segment(i, query, filter, visit);
+            }
+        }
+
+        // scan() delivering whole blocks; see scan_segment_blocks
+        template <typename Fn>
+        void scan_blocks(const HybridVector<fpT, qT>& query, const IdFilter& filter, Fn&& visit_block,
+                         size_t part = 0, size_t num_parts = 1) const {
+            assert(part < num_parts);
+            for (size_t i = part; i < num_segments(); i += num_parts) {
+                scan_segment_blocks(i, query, filter, visit_block);
+            }
+        }
+
+        // Multi-query scan of segment i: live rows are taken in cache-sized
+        // blocks and every query is scored against a block before moving on,
+        // so each row is read from memory once per batch instead of once per
+        // query. Calls visit(query_index, id, squared_distance).
+        template <typename Fn>
+        void scan_segment_batch(size_t i,
+                                const std::vector<const HybridVector<fpT, qT>*>& queries,
+                                const std::vector<const IdFilter*>& filters,
+                                Fn&& visit) const {
+            assert(queries.size() == filters.size());
+
+            // Rows per block so a block stays well inside L2
+            constexpr size_t block_bytes = 128 * 1024;
+            const size_t row_bytes = m_half_size * (sizeof(fpT) + sizeof(qT));
+            const size_t block_rows = std::max<size_t>(1, block_bytes / std::max<size_t>(row_bytes, 1));
+
+            const Segment* seg = m_directory->segments[i];
+            std::vector<size_t> block;
+            block.reserve(block_rows);
+
+            // The first query's pass is the block's first touch, so it
+            // prefetches ahead within the block
+            const size_t distance = m_hints.prefetch_distance;
+            auto flush = [&] {
+                for (size_t q = 0; q < queries.size(); q++) {
+                    for (size_t j = 0; j < block.size(); j++) {
+                        size_t slot = block[j];
+                        if (q == 0 && distance != 0 && j + distance < block.size()) {
+                            seg->prefetch(block[j + distance], m_hints.streaming);
+                        }
+                        u64 id = seg->id(slot);
+                        if (filters[q]->allows(id)) {
+                            visit(q, id, queries[q]->squared_distance_to(seg->fp(slot), seg->q(slot), seg->scale(slot)));
+                        }
+                    }
+                }
+                block.clear();
+            };
+
+            size_t words = (seg->num_reserved() + 63) / 64;
+            for (size_t w = 0; w < words; w++) {
+                u64 mask = seg->live_mask(w);
+                while (mask != 0) {
+                    block.push_back(w * 64 + __builtin_ctzll(mask));
+                    mask &= mask - 1;
+                    if (block.size() == block_rows) {
+                        flush();
+                    }
+                }
+            }
+            flush();
+        }
+    };
+
+    Snapshot snapshot() const {
+        auto guard = m_epochs.pin();
+        const Directory* dir = &m_load();
+        return Snapshot(std::move(guard), dir, m_half_size, scan_hints());
+    }
+
+    // Calls visit(id, squared_distance) for every live row allowed by the
+    // filter; see Snapshot::scan. Stripes scanned by separate calls may see
+    // different directories, so concurrent stripes should share one snapshot.
+    template <typename Fn>
+    void scan(const HybridVector<fpT, qT>& query, const IdFilter& filter, Fn&& visit,
+              size_t part = 0, size_t num_parts = 1) const {
+        snapshot().scan(query, filter, visit, part, num_parts);
+    }
+
+    // Top-k search. With scan_hints().threads != 1 the snapshot's segments
+    // are striped over pool threads (see scan_threads); a filter predicate
+    // must then be thread-safe.
+    std::vector<Neighbor<fpT>> search(const HybridVector<fpT, qT>& query,
+                                      size_t k,
+                                      const IdFilter& filter = IdFilter(),
+                                      WorkerPool& pool = default_worker_pool()) const {
+        const Snapshot snap = snapshot();
+        size_t threads = 1;
+        if (snap.hints().threads != 1) {
+            threads = std::min(scan_threads(snap.hints(), snap.num_rows(), pool), snap.num_segments());
+        }
+
+        TopK<fpT> top(k);
+        if (threads <= 1) {
+            snap.scan_blocks(query, filter, [&](const size_t* ids, const fpT* distances, size_t n) {
+                top.push_block(ids, distances, n);
+            });
+            return top.take_sorted();
+        }
+
+        auto lease = pool.lease();
+        pool.run([&](size_t t) {
+            auto& partial = pool.scratch(t).get<TopK<fpT>>();
+            partial.reset(k);
+            snap.scan_blocks(query, filter, [&](const size_t* ids, const fpT* distances, size_t n) {
+                partial.push_block(ids, distances, n);
+            }, t, threads);
+        }, threads);
+        for (size_t t = 0; t < threads; t++) {
+            top.merge(pool.scratch(t).get<TopK<fpT>>());
+        }
+        return top.take_sorted();
+    }
+
+    // Rewrites every sealed segment whose deleted fraction is at least
+    // min_dead_ratio; fully deleted segments are dropped. Returns the number
+    // of segments rewritten or dropped. Readers and appenders keep running.
+    size_t compact(double min_dead_ratio = 0.25) {
+        // One compaction at a time, so candidates cannot be freed under us
+        std::lock_guard compaction_lock(m_compaction_mutex);
+
+        std::vector<Segment*> candidates;
+        {
+            auto guard = m_epochs.pin();
+            const Directory& dir = m_load();
+            for (size_t i = 0; i + 1 < dir.segments.size(); i++) {
+                const Segment& seg = *dir.segments[i];
+                if (seg.num_deleted() > 0 &&
+                    seg.num_deleted() >= min_dead_ratio * seg.num_reserved()) {
+                    candidates.push_back(dir.segments[i]);
+                }
+            }
+        }
+        if (candidates.empty()) {
+            return 0;
+        }
+
+        // Candidates are full, but appenders may still be writing slots they
+        // reserved. Appenders stay pinned from reserve() to write(), so once
+        // every reader pinned now has left, all reserved slots are published
+        // and the candidates are sealed.
+        m_epochs.synchronize();
+
+        size_t rewritten = 0;
+        for (Segment* old_seg : candidates) {
+            // Copy without blocking appenders
+            Segment* compacted = m_rewrite(*old_seg);
+            {
+                std::lock_guard lock(m_writer_mutex);
+                const Directory& dir = m_load();
+                auto it = std::find(dir.segments.begin(), dir.segments.end(), old_seg);
+                if (it == dir.segments.end()) {
+                    delete compacted;
+                    continue;
+                }
+                Directory* next = new Directory(dir);
+                next->segments[static_cast<size_t>(it - dir.segments.begin())] = compacted;
+                m_publish(next);
+            }
+
+            // Erasers still pinned on the old directory may tombstone rows in
+            // old_seg; wait them out, then carry every delete over
+            m_epochs.synchronize();
+            size_t live = 0;
+            for (size_t slot = 0; slot < compacted->num_reserved(); slot++) {
+                if (old_seg->deleted(old_seg->find(compacted->id(slot)))) {
+                    compacted->erase(slot);
+                } else {
+                    live++;
+                }
+            }
+            m_epochs.retire([old_seg] { delete old_seg; });
+
+            if (live == 0) {
+                std::lock_guard lock(m_writer_mutex);
+                Directory* pruned = new Directory(m_load());
+                pruned->segments.erase(std::find(pruned->segments.begin(), pruned->segments.end(), compacted));
+                m_publish(pruned);
+                m_epochs.retire([compacted] { delete compacted; });
+            }
+            rewritten++;
+        }
+        return rewritten;
+    }
+
+    // Runs compact(min_dead_ratio) every interval on a background thread
+    void start_compaction(std::chrono::milliseconds interval, double min_dead_ratio = 0.25) {
+        stop_compaction();
+        m_compactor_stop = false;
+        m_compactor = std::thread([this, interval, min_dead_ratio] {
+            std::unique_lock lock(m_compactor_mutex);
+            while (!m_compactor_cv.wait_for(lock, interval, [this] { return m_compactor_stop; })) {
+                lock.unlock();
+                compact(min_dead_ratio);
+                lock.lock();
+            }
+        });
+    }
+
+    void stop_compaction() {
+        if (!m_compactor.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard lock(m_compactor_mutex);
+            m_compactor_stop = true;
+        }
+        m_compactor_cv.notify_all();
+        m_compactor.join();
+    }
+};
@@ -0,0 +1,229 @@
+#pragma once
+
+#include "hybrid_search.hpp"
+
+// Read-only copy of a collection in a vertical (AoSoA) layout: vectors are
+// grouped in blocks of Width, and within a block dimension d of all Width
+// vectors is stored contiguously. Each query element is broadcast across the
+// lanes in a register and scoring a block updates independent accumulators
+// per lane, so every lane ends up holding a full distance with no per-pair
+// horizontal reduction. This pays off most for short vectors, where the
+// reduction at the end of each squared_distance_to call is a large share of
+// the work.
+template <typename fpT, typename qT, size_t Width = 16>
+class TransposedCollection {
+    static_assert(Width == 8 || Width == 16, "TransposedCollection blocks hold 8 or 16 vectors");
+
+private:
+    size_t m_size = 0;
+    size_t m_half_size = 0;
+    size_t m_num_blocks = 0;
+
+    // m_fp[(block * half_size + d) * Width + lane]; likewise m_q
+    std::vector<fpT> m_fp;
+    std::vector<qT> m_q;
+    // Per-vector scale, Width entries per block; padding lanes hold 0
+    std::vector<fpT> m_scale;
+    // Per-vector HybridVectorStats, indexed like m_scale; empty unless every
+    // vector of the collection has them
+    std::vector<HybridVectorStats<fpT>> m_stats;
+
+    using diff_t = typename HybridCodeAccumulator<qT>::diff_t;
+    using acc_t = typename HybridCodeAccumulator<qT>::acc_t;
+    static constexpr size_t flush_steps = HybridCodeAccumulator<qT>::flush_steps;
+
+    // The block kernel takes hybrid_kernel_lanes contiguous values per step,
+    // i.e. step_dims dimensions, so 8-bit codes fill whole vector registers.
+    // Accumulator j only ever sees lane j % Width of dimension j / Width, so
+    // the step_dims groups of accumulators form independent chains.
+    static constexpr size_t step_dims = hybrid_kernel_lanes / Width;
+
+    // values[j / Width] by selects rather than an indexed load, so that inside
+    // the kernel each group of lanes gets its query element by a register
+    // broadcast
+    template <typename T>
+    static T m_step_value(const T (&values)[step_dims], size_t j) {
+        if constexpr (step_dims == 2) {
+            return j < Width ? values[0] : values[1];
+        } else {
+            return j < Width ? values[0] : j < 2 * Width ? values[1] : j < 3 * Width ? values[2] : values[3];
+        }
+    }
+
+public:
+    explicit TransposedCollection(const std::vector<HybridVector<fpT, qT>>& collection)
+        : m_size(collection.size()),
+          m_half_size(collection.empty() ? 0 : collection[0].half_size()),
+          m_num_blocks((collection.size() + Width - 1) / Width),
+          m_fp(m_num_blocks * m_half_size * Width, 0),
+          m_q(m_num_blocks * m_half_size * Width, 0),
+          m_scale(m_num_blocks * Width, 0) {
+        for (size_t id = 0; id < m_size; id++) {
+            const HybridVector<fpT, qT>& vec = collection[id];
+            assert(vec.half_size() == m_half_size);
+
+            const size_t block = id / Width;
+            const size_t lane = id % Width;
+            fpT* fp = m_fp.data() + block * m_half_size * Width + lane;
+            qT* q = m_q.data() + block * m_half_size * Width + lane;
+            for (size_t d = 0; d < m_half_size; d++) {
+                fp[d * Width] = vec.fp_half()[d];
+                q[d * Width] = vec.q_half()[d];
+            }
+            m_scale[id] = vec.scale();
+        }
+
+        const bool all_stats = std::all_of(collection.begin(), collection.end(),
+                                           [](const HybridVector<fpT, qT>& vec) { return vec.has_stats(); });
+        if (m_size != 0 && all_stats) {
+            m_stats.resize(m_num_blocks * Width);
+            for (size_t id = 0; id < m_size; id++) {
+                m_stats[id] = collection[id].stats();
+            }
+        }
+    }
+
+    size_t size() const { return m_size; }
+    size_t half_size() const { return m_half_size; }
+    size_t num_blocks() const { return m_num_blocks; }
+
+    // Stats of the vector with this id, e.g. for norm-based pruning of the
+    // rows a scan_blocks visitor receives; kept when every vector had them
+    bool has_stats() const { return !m_stats.empty(); }
+    const HybridVectorStats<fpT>& stats(size_t id) const {
+        assert(has_stats() && id < m_size);
+        return m_stats[id];
+    }
+
+    // The query's halves and effective scale. Each element is broadcast
+    // across the Width lanes in a register as the block kernel reaches it, so
+    // the query is read once per block rather than Width times.
+    struct BroadcastQuery {
+        const fpT* fp;
+        const qT* q;
+        fpT scale;
+    };
+
+    BroadcastQuery broadcast(const HybridVector<fpT, qT>& query) const {
+        assert(query.half_size() == m_half_size);
+        // Zero-range queries ignore the q half, as in squared_distance_to
+        const fpT scale = (query.fp_max() == query.fp_min()) ? static_cast<fpT>(0) : query.scale();
+        return BroadcastQuery{query.fp_half(), query.q_half(), scale};
+    }
+
+    // Squared distances from the query to the Width vectors of block b,
+    // written to distances[0..Width); padding lanes past size() hold garbage
+    void block_distances(size_t b, const BroadcastQuery& query, fpT* distances) const {
+        constexpr size_t lanes = hybrid_kernel_lanes;
+
+        const size_t n = m_half_size;
+        const fpT* fp = m_fp.data() + b * n * Width;
+        const qT* q = m_q.data() + b * n * Width;
+
+        fpT fp_acc[lanes] = {};
+        std::int64_t q_total[lanes] = {};
+
+        size_t d = 0;
+        while (d < n) {
+            const size_t chunk_end = (n - d > step_dims * flush_steps) ? d + step_dims * flush_steps : n;
+            acc_t q_acc[lanes] = {};
+
+            for (; d + step_dims <= chunk_end; d += step_dims) {
+                fpT query_fp[step_dims];
+                diff_t query_q[step_dims];
+                for (size_t s = 0; s < step_dims; s++) {
+                    query_fp[s] = query.fp[d + s];
+                    query_q[s] = static_cast<diff_t>(query.q[d + s]);
+                }
+
+                const fpT* block_fp = fp + d * Width;
+                const qT* block_q = q + d * Width;
+#pragma omp simd
+                for (size_t j = 0; j < lanes; j++) {
+                    fpT fp_diff = block_fp[j] - m_step_value(query_fp, j);
+                    fp_acc[j] += fp_diff * fp_diff;
+
+                    diff_t q_diff = static_cast<diff_t>(block_q[j]) - m_step_value(query_q, j);
+                    q_acc[j] += static_cast<acc_t>(q_diff) * q_diff;
+                }
+            }
+            // Fewer than step_dims dimensions left in the half
+            for (; d < chunk_end; d++) {
+                for (size_t lane = 0; lane < Width; lane++) {
+                    fpT fp_diff = fp[d * Width + lane] - query.fp[d];
+                    fp_acc[lane] += fp_diff * fp_diff;
+
+                    diff_t q_diff = static_cast<diff_t>(q[d * Width + lane]) - static_cast<diff_t>(query.q[d]);
+                    q_acc[lane] += static_cast<acc_t>(q_diff) * q_diff;
+                }
+            }
+
+            for (size_t j = 0; j < lanes; j++) {
+                q_total[j] += q_acc[j];
+            }
+        }
+
+        for (size_t j = Width; j < lanes; j++) {
+            fp_acc[j % Width] += fp_acc[j];
+            q_total[j % Width] += q_total[j];
+        }
+
+        const fpT* scale = m_scale.data() + b * Width;
+        for (size_t lane = 0; lane < Width; lane++) {
+            distances[lane] = fp_acc[lane] + static_cast<fpT>(q_total[lane]) * (query.scale * scale[lane]);
+        }
+    }
+
+    // Calls visit_block(ids, squared_distances, n) once per block with the
+    // rows the filter allows. Blocks whose ids the bitset rejects entirely
+    // are skipped without touching their data.
+    template <typename Fn>
+    void scan_blocks(const HybridVector<fpT, qT>& query, const IdFilter& filter, Fn&& visit_block) const {
+        constexpr u64 lanes_mask = (u64(1) << Width) - 1;
+
+        const BroadcastQuery broadcast_query = broadcast(query);
+        fpT distances[Width];
+        size_t ids[Width];
+        fpT kept[Width];
+        for (size_t b = 0; b < m_num_blocks; b++) {
+            const size_t base = b * Width;
+            u64 mask = (filter.word_mask(base / 64) >> (base % 64)) & lanes_mask;
+            if (m_size - base < Width) {
+                mask &= (u64(1) << (m_size - base)) - 1;
+            }
+            if (mask == 0) {
+                continue;
+            }
+
+            block_distances(b, broadcast_query, distances);
+
+            size_t n = 0;
+            while (mask != 0) {
+                size_t lane = __builtin_ctzll(mask);
+                mask &= mask - 1;
+                if (filter.allows(base + lane)) {
+                    ids[n] = base + lane;
+                    kept[n] = distances[lane];
+                    n++;
+                }
+            }
+            if (n != 0) {
+                visit_block(ids, kept, n);
+            }
+        }
+    }
+};
+
+// Exact k-nearest-neighbour search over a transposed collection; ids and
+// results match search() over the collection it was built from
+template <typename fpT, typename qT, size_t Width>
+std::vector<Neighbor<fpT>> search(const TransposedCollection<fpT, qT, Width>& collection,
+                                  const HybridVector<fpT, qT>& query,
+                                  size_t k,
+                                  const IdFilter& filter = IdFilter()) {
+    TopK<fpT> top(k);
+    collection.scan_blocks(query, filter, [&](const size_t* ids, const fpT* distances, size_t n) {
+        top.push_block(ids, distances, n);
+    });
+    return top.take_sorted();
+}
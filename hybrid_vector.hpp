@@ -1,3 +1,5 @@
+#pragma once
+
 #include <iostream>
 #include <vector>
 #include <algorithm>
@@ -7,6 +9,11 @@
 #include <random>
 #include <cassert>
 #include <memory>
+#include <limits>
+#include <type_traits>
+#include <array>
+#include <memory_resource>
+#include <optional>
 #include <omp.h>
 
 #ifndef N_DIM
@@ -15,14 +22,432 @@
 
 using u64 = std::uint64_t;
 
+// Independent accumulator lanes per half in hybrid_squared_distance. Enough
+// to hide FMA latency while the fp accumulators still fit in AVX2 registers.
+constexpr size_t hybrid_kernel_lanes = 32;
+
+// Integer widths and flush interval for accumulating squared code
+// differences, shared by every kernel over q halves. 8-bit codes: differences
+// fit int16 (widening multiply, e.g. pmaddwd) and 255² per step fits an int32
+// lane for flush_steps steps; wider codes accumulate in int64 directly.
+template <typename qT>
+struct HybridCodeAccumulator {
+    using diff_t = typename std::conditional<sizeof(qT) == 1, std::int16_t, std::int64_t>::type;
+    using acc_t = typename std::conditional<sizeof(qT) == 1, std::int32_t, std::int64_t>::type;
+    static constexpr size_t flush_steps = (sizeof(qT) == 1) ? 32768 : (size_t(1) << 30);
+};
+
+// Interleaved fp/q squared-distance kernel over n elements of each half.
+// The float half and the integer half keep separate accumulator lanes, so
+// FMA work and integer ALU work form independent dependency chains that can
+// issue on different execution ports in the same cycles. Integer partial sums
+// are exact and converted to fpT once, then scaled by scale_squared.
+// A non-zero N fixes n at compile time (it must equal n): the loops then have
+// constant trip counts, and a multiple of hybrid_kernel_lanes has no tail.
+template <typename fpT, typename qT, size_t N = 0>
+fpT hybrid_squared_distance(const fpT* a_fp, const qT* a_q,
+                            const fpT* b_fp, const qT* b_q,
+                            size_t n, fpT scale_squared) {
+    assert(N == 0 || n == N);
+    if (N != 0) {
+        n = N;
+    }
+
+    using diff_t = typename HybridCodeAccumulator<qT>::diff_t;
+    using acc_t = typename HybridCodeAccumulator<qT>::acc_t;
+    constexpr size_t lanes = hybrid_kernel_lanes;
+    constexpr size_t flush_steps = HybridCodeAccumulator<qT>::flush_steps;
+
+    fpT fp_acc[lanes] = {};
+    std::int64_t q_total = 0;
+
+    const size_t body = n - n % lanes;
+    size_t i = 0;
+    while (i < body) {
+        const size_t block_end = (body - i > lanes * flush_steps) ? i + lanes * flush_steps : body;
+        acc_t q_acc[lanes] = {};
+
+        for (; i < block_end; i += lanes) {
+#pragma omp simd
+            for (size_t j = 0; j < lanes; j++) {
+                fpT fp_diff = a_fp[i + j] - b_fp[i + j];
+                fp_acc[j] += fp_diff * fp_diff;
+
+                diff_t q_diff = static_cast<diff_t>(a_q[i + j]) - static_cast<diff_t>(b_q[i + j]);
+                q_acc[j] += static_cast<acc_t>(q_diff) * q_diff;
+            }
+        }
+
+        for (size_t j = 0; j < lanes; j++) {
+            q_total += q_acc[j];
+        }
+    }
+
+    fpT fp_sum = 0;
+    for (size_t j = 0; j < lanes; j++) {
+        fp_sum += fp_acc[j];
+    }
+
+    for (; i < n; i++) {
+        fpT fp_diff = a_fp[i] - b_fp[i];
+        fp_sum += fp_diff * fp_diff;
+
+        std::int64_t q_diff = static_cast<std::int64_t>(a_q[i]) - static_cast<std::int64_t>(b_q[i]);
+        q_total += q_diff * q_diff;
+    }
+
+    return fp_sum + static_cast<fpT>(q_total) * scale_squared;
+}
+
+// Integer statistics of a q half. Dequantization is affine, so sums, norms
+// and the mean of the dequantized values follow from these exactly (see
+// hybrid_q_sum and friends) without dequantizing any element.
+struct HybridCodeStats {
+    std::int64_t sum = 0;          // Σ code
+    std::int64_t sum_squares = 0;  // Σ code²
+    std::int64_t sum_upper = 0;    // Σ code over codes >= first_nonnegative
+    std::int64_t count_upper = 0;  // number of such codes
+};
+
+// Optional per-vector statistics, kept with the vector (and its copies) so
+// norm-based distance forms, pruning and error bounds need no extra pass.
+// The quantization error compares the q half with the values it encodes.
+template <typename fpT>
+struct HybridVectorStats {
+    fpT fp_squared_norm = 0;         // Σ fp²
+    fpT q_squared_norm = 0;          // Σ dequantized q²
+    fpT sum = 0;                     // Σ over both halves
+    fpT quantization_rms_error = 0;  // sqrt(mean((value - dequantized)²)) over the q half
+};
+
+// Constructor tag requesting HybridVectorStats
+struct hybrid_with_stats_t {
+    explicit hybrid_with_stats_t() = default;
+};
+inline constexpr hybrid_with_stats_t hybrid_with_stats{};
+
+// first_nonnegative is the lowest code that dequantizes to a value >= 0
+// (clamped to [0, max code + 1]); it splits codes for the L1 norm
+template <typename qT>
+HybridCodeStats hybrid_code_stats(const qT* q, size_t n, std::int64_t first_nonnegative) {
+    // 8-bit codes: 32-bit sums of 255² cannot overflow within 32768 elements
+    using acc_t = typename std::conditional<sizeof(qT) == 1, std::uint32_t, std::int64_t>::type;
+    constexpr size_t chunk = (sizeof(qT) == 1) ? 32768 : (size_t(1) << 30);
+    const acc_t threshold = static_cast<acc_t>(first_nonnegative);
+
+    HybridCodeStats stats;
+    for (size_t begin = 0; begin < n; begin += chunk) {
+        const size_t end = std::min(n, begin + chunk);
+        acc_t sum = 0, sum_squares = 0, sum_upper = 0, count_upper = 0;
+#pragma omp simd reduction(+:sum, sum_squares, sum_upper, count_upper)
+        for (size_t i = begin; i < end; i++) {
+            acc_t code = q[i];
+            acc_t upper = code >= threshold ? 1 : 0;
+            sum += code;
+            sum_squares += code * code;
+            sum_upper += upper * code;
+            count_upper += upper;
+        }
+        stats.sum += sum;
+        stats.sum_squares += sum_squares;
+        stats.sum_upper += sum_upper;
+        stats.count_upper += count_upper;
+    }
+    return stats;
+}
+
+// Lowest code at or above offset, i.e. the first that dequantizes to >= 0
 template <typename fpT, typename qT>
-class HybridVector {
+std::int64_t hybrid_first_nonnegative_code(fpT offset) {
+    const fpT max_code = static_cast<fpT>(std::numeric_limits<qT>::max());
+    return static_cast<std::int64_t>(std::ceil(std::clamp(offset, static_cast<fpT>(0), max_code + 1)));
+}
+
+// Σ of the dequantized q half: scale * Σcode - n * offset * scale
+template <typename V>
+auto hybrid_q_sum(const V& vec) {
+    using fpT = decltype(vec.scale());
+    const fpT n = static_cast<fpT>(vec.half_size());
+    if (vec.fp_max() == vec.fp_min()) {
+        return n * vec.fp_min();
+    }
+    return vec.scale() * (static_cast<fpT>(vec.code_stats().sum) - n * vec.offset());
+}
+
+// Σ|value| of the dequantized q half: codes below offset give negative values
+template <typename V>
+auto hybrid_q_l1_norm(const V& vec) {
+    using fpT = decltype(vec.scale());
+    const HybridCodeStats& stats = vec.code_stats();
+    if (vec.fp_max() == vec.fp_min()) {
+        return static_cast<fpT>(vec.half_size()) * std::abs(vec.fp_min());
+    }
+    const double offset = vec.offset();
+    const double count_lower = static_cast<double>(vec.half_size()) - static_cast<double>(stats.count_upper);
+    const double sum_lower = static_cast<double>(stats.sum - stats.sum_upper);
+    const double upper = static_cast<double>(stats.sum_upper) - static_cast<double>(stats.count_upper) * offset;
+    const double lower = count_lower * offset - sum_lower;
+    return static_cast<fpT>(vec.scale() * (upper + lower));
+}
+
+// Σvalue² of the dequantized q half: scale² * (Σcode² - 2 offset Σcode + n offset²),
+// combined in double because the terms can be much larger than the result
+template <typename V>
+auto hybrid_q_squared_norm(const V& vec) {
+    using fpT = decltype(vec.scale());
+    const HybridCodeStats& stats = vec.code_stats();
+    const double n = static_cast<double>(vec.half_size());
+    if (vec.fp_max() == vec.fp_min()) {
+        return static_cast<fpT>(n * vec.fp_min() * vec.fp_min());
+    }
+    const double offset = vec.offset();
+    const double scale = vec.scale();
+    const double centred = static_cast<double>(stats.sum_squares) - 2 * offset * static_cast<double>(stats.sum) +
+                           n * offset * offset;
+    return static_cast<fpT>(scale * scale * std::max(centred, 0.0));
+}
+
+// Σ, Σ|x| and Σx² of an fp half
+template <typename fpT>
+fpT hybrid_fp_sum(const fpT* fp, size_t n) {
+    fpT sum = 0;
+#pragma omp simd reduction(+:sum)
+    for (size_t i = 0; i < n; i++) {
+        sum += fp[i];
+    }
+    return sum;
+}
+
+template <typename fpT>
+fpT hybrid_fp_l1_norm(const fpT* fp, size_t n) {
+    fpT sum = 0;
+#pragma omp simd reduction(+:sum)
+    for (size_t i = 0; i < n; i++) {
+        sum += std::abs(fp[i]);
+    }
+    return sum;
+}
+
+template <typename fpT>
+fpT hybrid_fp_squared_norm(const fpT* fp, size_t n) {
+    fpT sum = 0;
+#pragma omp simd reduction(+:sum)
+    for (size_t i = 0; i < n; i++) {
+        sum += fp[i] * fp[i];
+    }
+    return sum;
+}
+
+// Dim value selecting the runtime-sized HybridVector
+constexpr size_t dynamic_dim = 0;
+
+// HybridVector<fpT, qT> sizes itself at run time; HybridVector<fpT, qT, Dim>
+// (defined below) fixes the dimension at compile time
+template <typename fpT, typename qT, size_t Dim = dynamic_dim>
+class HybridVector;
+
+// Lazy elementwise arithmetic. a + b, a - b and a * b on HybridVectors build
+// HybridExpr nodes instead of vectors; the whole expression is evaluated in
+// one fused pass, element by element, only when it is assigned to a
+// HybridVector, used with a compound operator or reduced with accumulate().
+// Both halves are computed in fpT: q codes are dequantized with their own
+// vector's parameters, so operands with different ranges combine correctly.
+// Assignment requantizes the q half with parameters fitted to the result.
+// Nodes hold vectors by reference: evaluate an expression before its
+// operands go out of scope.
+template <typename T>
+struct is_hybrid_vector : std::false_type {};
+
+template <typename fpT, typename qT, size_t Dim>
+struct is_hybrid_vector<HybridVector<fpT, qT, Dim>> : std::true_type {};
+
+template <typename Op, typename L, typename R>
+class HybridExpr;
+
+template <typename V>
+class HybridDense;
+
+// Nodes that evaluate lazily and can be assigned to a HybridVector
+template <typename T>
+struct is_hybrid_expr : std::false_type {};
+
+template <typename Op, typename L, typename R>
+struct is_hybrid_expr<HybridExpr<Op, L, R>> : std::true_type {};
+
+template <typename V>
+struct is_hybrid_expr<HybridDense<V>> : std::true_type {};
+
+// Dequantization of a vector's q half in affine form, value = code * scale + bias.
+// A zero-range vector has scale 0 and bias fp_min().
+template <typename fpT>
+struct HybridAffine {
+    fpT scale;
+    fpT bias;
+};
+
+template <typename V>
+auto hybrid_affine(const V& vec) {
+    using fpT = decltype(vec.scale());
+    if (vec.fp_max() == vec.fp_min()) {
+        return HybridAffine<fpT>{0, vec.fp_min()};
+    }
+    return HybridAffine<fpT>{vec.scale(), -vec.offset() * vec.scale()};
+}
+
+// Min/max quantization under fixed parameters that clamps values outside
+// the range to the end codes instead of wrapping. Loops hold it by value, so
+// stores to a q half cannot alias the parameters.
+template <typename fpT, typename qT>
+struct HybridSaturatingQuantizer {
+    fpT scale;
+    fpT offset;
+    bool zero_range;
+
+    qT operator()(fpT x) const {
+        fpT code = (x / scale) + offset;
+        code = std::max(code, static_cast<fpT>(0));
+        code = std::min(code, static_cast<fpT>(std::numeric_limits<qT>::max()));
+        return zero_range ? static_cast<qT>(0) : static_cast<qT>(code);
+    }
+};
+
+// Leaf node over one vector. It keeps the raw half pointers and the
+// dequantization parameters, so evaluation loops see plain loads rather than
+// reloading them through the vector.
+template <typename V>
+class HybridTerminal {
 private:
-    size_t m_size;
+    using fpT = decltype(std::declval<const V&>().scale());
+
+    size_t m_half_size;
+    decltype(std::declval<const V&>().fp_half()) m_fp;
+    decltype(std::declval<const V&>().q_half()) m_q;
+    HybridAffine<fpT> m_affine;
+
+public:
+    using vector_type = V;
 
-    std::vector<fpT> m_fp_half;
-    std::vector<qT> m_q_half;
+    explicit HybridTerminal(const V& vec)
+        : m_half_size(vec.half_size()), m_fp(vec.fp_half()), m_q(vec.q_half()), m_affine(hybrid_affine(vec)) {}
 
+    size_t half_size() const { return m_half_size; }
+    fpT fp(size_t i) const { return m_fp[i]; }
+    fpT q(size_t i) const { return static_cast<fpT>(m_q[i]) * m_affine.scale + m_affine.bias; }
+};
+
+// Leaf node over plain fpT buffers holding both halves, times a factor;
+// used to requantize batched sums
+template <typename V>
+class HybridDense {
+private:
+    using fpT = decltype(std::declval<const V&>().scale());
+
+    size_t m_half_size;
+    const fpT* m_fp;
+    const fpT* m_q;
+    fpT m_factor;
+
+public:
+    using vector_type = V;
+
+    HybridDense(const fpT* fp, const fpT* q, size_t half_size, fpT factor = 1)
+        : m_half_size(half_size), m_fp(fp), m_q(q), m_factor(factor) {}
+
+    size_t half_size() const { return m_half_size; }
+    fpT fp(size_t i) const { return m_fp[i] * m_factor; }
+    fpT q(size_t i) const { return m_q[i] * m_factor; }
+};
+
+// Vectors become terminals; expressions are used as they are
+template <typename T>
+auto hybrid_operand(const T& operand) {
+    if constexpr (is_hybrid_vector<T>::value) {
+        return HybridTerminal<T>(operand);
+    } else {
+        return operand;
+    }
+}
+
+struct HybridAdd {
+    template <typename T>
+    static T apply(T a, T b) { return a + b; }
+};
+
+struct HybridSubtract {
+    template <typename T>
+    static T apply(T a, T b) { return a - b; }
+};
+
+struct HybridMultiply {
+    template <typename T>
+    static T apply(T a, T b) { return a * b; }
+};
+
+template <typename Op, typename L, typename R>
+class HybridExpr {
+private:
+    L m_lhs;
+    R m_rhs;
+
+public:
+    using vector_type = typename L::vector_type;
+    static_assert(std::is_same<vector_type, typename R::vector_type>::value,
+                  "HybridVector expressions need operands of one type");
+
+    HybridExpr(L lhs, R rhs) : m_lhs(lhs), m_rhs(rhs) {
+        assert(m_lhs.half_size() == m_rhs.half_size());
+    }
+
+    size_t half_size() const { return m_lhs.half_size(); }
+    auto fp(size_t i) const { return Op::apply(m_lhs.fp(i), m_rhs.fp(i)); }
+    auto q(size_t i) const { return Op::apply(m_lhs.q(i), m_rhs.q(i)); }
+
+    // Sum of the result's elements before requantization
+    auto accumulate() const {
+        decltype(fp(0)) sum = 0;
+        const size_t n = half_size();
+#pragma omp simd reduction(+:sum)
+        for (size_t i = 0; i < n; i++) {
+            sum += fp(i);
+            sum += q(i);
+        }
+        return sum;
+    }
+};
+
+template <typename T>
+struct is_hybrid_operand
+    : std::integral_constant<bool, is_hybrid_vector<T>::value || is_hybrid_expr<T>::value> {};
+
+template <typename Op, typename L, typename R>
+using hybrid_expr_t = HybridExpr<Op, decltype(hybrid_operand(std::declval<L>())),
+                                 decltype(hybrid_operand(std::declval<R>()))>;
+
+template <typename L, typename R,
+          typename = std::enable_if_t<is_hybrid_operand<L>::value && is_hybrid_operand<R>::value>>
+hybrid_expr_t<HybridAdd, L, R> operator+(const L& lhs, const R& rhs) {
+    return {hybrid_operand(lhs), hybrid_operand(rhs)};
+}
+
+template <typename L, typename R,
+          typename = std::enable_if_t<is_hybrid_operand<L>::value && is_hybrid_operand<R>::value>>
+hybrid_expr_t<HybridSubtract, L, R> operator-(const L& lhs, const R& rhs) {
+    return {hybrid_operand(lhs), hybrid_operand(rhs)};
+}
+
+template <typename L, typename R,
+          typename = std::enable_if_t<is_hybrid_operand<L>::value && is_hybrid_operand<R>::value>>
+hybrid_expr_t<HybridMultiply, L, R> operator*(const L& lhs, const R& rhs) {
+    return {hybrid_operand(lhs), hybrid_operand(rhs)};
+}
+
+// Quantization parameters, cached statistics and the requantizing loops
+// shared by the runtime-sized and fixed-dimension HybridVector (CRTP).
+// Derived provides half_size(), fp_half() and q_half(); when half_size() is
+// constexpr the loops here keep constant trip counts.
+template <typename Derived, typename fpT, typename qT>
+class HybridVectorBase {
+protected:
     fpT m_fp_min;
     fpT m_fp_max;
 
@@ -32,29 +457,62 @@ private:
     fpT m_scale;
     fpT m_offset;
 
-    qT m_quantize_fp(const fpT x) {
-        if (m_fp_max == m_fp_min) {
-            return static_cast<qT>(0);  // All values are the same
-        }
-        return static_cast<qT>((x / m_scale) + m_offset);
+    // Recomputed whenever the q half changes
+    HybridCodeStats m_code_stats;
+    // Present when requested at construction; kept up to date from then on
+    std::optional<HybridVectorStats<fpT>> m_stats;
+
+    const Derived& m_derived() const { return static_cast<const Derived&>(*this); }
+
+    void m_update_code_stats() {
+        m_code_stats = hybrid_code_stats(m_derived().q_half(), m_derived().half_size(),
+                                         hybrid_first_nonnegative_code<fpT, qT>(m_offset));
     }
 
-    fpT m_dequantize_q(const qT x) const {
-        if (m_fp_max == m_fp_min) {
-            return m_fp_min;  // All values are the same, return the constant value
+    // Σ(original[i] - dequantized q[i])² over the q half
+    fpT m_squared_error(const fpT* original) const {
+        const HybridAffine<fpT> affine = hybrid_affine(*this);
+        const qT* q = m_derived().q_half();
+        const size_t n = m_derived().half_size();
+        fpT error = 0;
+#pragma omp simd reduction(+:error)
+        for (size_t i = 0; i < n; i++) {
+            fpT diff = original[i] - (static_cast<fpT>(q[i]) * affine.scale + affine.bias);
+            error += diff * diff;
         }
-        return (static_cast<fpT>(x) - m_offset) * m_scale;
+        return error;
     }
 
-public:
+    // Call after m_update_code_stats()
+    void m_set_stats(fpT squared_error) {
+        const fpT* fp = m_derived().fp_half();
+        const size_t n = m_derived().half_size();
+        HybridVectorStats<fpT> stats;
+        stats.fp_squared_norm = hybrid_fp_squared_norm(fp, n);
+        stats.q_squared_norm = hybrid_q_squared_norm(m_derived());
+        stats.sum = hybrid_fp_sum(fp, n) + hybrid_q_sum(m_derived());
+        stats.quantization_rms_error = (n == 0) ? static_cast<fpT>(0) : std::sqrt(squared_error / static_cast<fpT>(n));
+        m_stats = stats;
+    }
 
-    HybridVector(const std::vector<fpT> &vec) {
-        auto it_min = std::min_element(vec.begin(), vec.end());
-        m_fp_min = *it_min;
+    qT m_quantize_fp(const fpT x) const {
+        if (m_fp_max == m_fp_min) {
+            return static_cast<qT>(0);  // All values are the same
+        }
+        return static_cast<qT>((x / m_scale) + m_offset);
+    }
 
-        auto it_max = std::max_element(vec.begin(), vec.end());
-        m_fp_max = *it_max;
+    fpT m_scale_squared(fpT other_scale) const {
+        // Linearized quantized computation:
+        // (dequantize(a) - dequantize(b))² = scale² * (a - b)²
+        // With zero range every q difference is 0, so the q half contributes nothing.
+        return (m_fp_max == m_fp_min) ? static_cast<fpT>(0) : m_scale * other_scale;
+    }
 
+    // Fits the quantization parameters to values in [lo, hi]
+    void m_fit_range(fpT lo, fpT hi) {
+        m_fp_min = lo;
+        m_fp_max = hi;
         m_scale = (m_fp_max - m_fp_min) / (m_q_max - m_q_min);
 
         // Handle edge case where all values are the same (zero range)
@@ -64,13 +522,159 @@ public:
         } else {
             m_offset = m_q_min - (m_fp_min / m_scale);
         }
+    }
+
+    // Fits the quantization parameters to expr's range over both halves
+    template <typename E>
+    void m_fit_expr(const E& expr) {
+        const size_t n = expr.half_size();
+        fpT lo = std::numeric_limits<fpT>::max();
+        fpT hi = std::numeric_limits<fpT>::lowest();
+#pragma omp simd reduction(min:lo) reduction(max:hi)
+        for (size_t i = 0; i < n; i++) {
+            fpT fp = expr.fp(i);
+            fpT q = expr.q(i);
+            lo = std::min(lo, std::min(fp, q));
+            hi = std::max(hi, std::max(fp, q));
+        }
+        if (n == 0) {
+            lo = hi = 0;
+        }
+        m_fit_range(lo, hi);
+    }
 
-        std::vector<fpT> working_vec = vec;
-        if (vec.size() % 2 == 0) {
-            working_vec.push_back(static_cast<fpT>(0));
+    HybridSaturatingQuantizer<fpT, qT> m_saturating_quantizer() const {
+        return {m_scale, m_offset, m_fp_max == m_fp_min};
+    }
+
+    // Evaluates expr into fp and q, the derived class's halves, under the
+    // current parameters and refreshes the cached statistics. q values
+    // outside [fp_min, fp_max] saturate at the end codes. Each index is read
+    // and written once, so expr may refer to *this, and the quantization
+    // error is taken in the same pass: once the codes are written, expr may
+    // no longer evaluate to the original values. expr is taken by value: a
+    // local copy lets the compiler prove that the byte stores to q do not
+    // modify the node's pointers.
+    template <typename E>
+    void m_store(const E expr, fpT* fp, qT* q) {
+        static_assert(std::is_same<typename E::vector_type, Derived>::value,
+                      "expression evaluates to a different HybridVector type");
+        const size_t n = m_derived().half_size();
+        assert(expr.half_size() == n);
+
+        const HybridSaturatingQuantizer<fpT, qT> quantize = m_saturating_quantizer();
+        const HybridAffine<fpT> affine = hybrid_affine(*this);
+        fpT error = 0;
+#pragma omp simd reduction(+:error)
+        for (size_t i = 0; i < n; i++) {
+            fpT value = expr.q(i);
+            qT code = quantize(value);
+            fp[i] = expr.fp(i);
+            q[i] = code;
+            fpT diff = value - (static_cast<fpT>(code) * affine.scale + affine.bias);
+            error += diff * diff;
+        }
+        m_update_code_stats();
+        if (m_stats) {
+            m_set_stats(error);
         }
+    }
+
+public:
+    fpT fp_min() const { return m_fp_min; }
+    fpT fp_max() const { return m_fp_max; }
+    fpT scale() const { return m_scale; }
+    fpT offset() const { return m_offset; }
+
+    const HybridCodeStats& code_stats() const { return m_code_stats; }
 
-        m_size = working_vec.size();
+    bool has_stats() const { return m_stats.has_value(); }
+
+    const HybridVectorStats<fpT>& stats() const {
+        assert(m_stats && "construct with hybrid_with_stats");
+        return *m_stats;
+    }
+
+    // Reductions over both halves. The q half comes from the cached code
+    // statistics in O(1); only the fp half is read, and not even that when
+    // HybridVectorStats are kept.
+    fpT accumulate() const {
+        if (m_stats) {
+            return m_stats->sum;
+        }
+        return hybrid_fp_sum(m_derived().fp_half(), m_derived().half_size()) + hybrid_q_sum(m_derived());
+    }
+
+    fpT mean() const {
+        const size_t n = m_derived().half_size();
+        return (n == 0) ? static_cast<fpT>(0) : accumulate() / static_cast<fpT>(2 * n);
+    }
+
+    fpT l1_norm() const {
+        return hybrid_fp_l1_norm(m_derived().fp_half(), m_derived().half_size()) + hybrid_q_l1_norm(m_derived());
+    }
+
+    fpT squared_norm() const {
+        if (m_stats) {
+            return m_stats->fp_squared_norm + m_stats->q_squared_norm;
+        }
+        return hybrid_fp_squared_norm(m_derived().fp_half(), m_derived().half_size()) +
+               hybrid_q_squared_norm(m_derived());
+    }
+};
+
+template <typename fpT, typename qT>
+class HybridVector<fpT, qT, dynamic_dim>
+    : public HybridVectorBase<HybridVector<fpT, qT, dynamic_dim>, fpT, qT> {
+private:
+    using Base = HybridVectorBase<HybridVector, fpT, qT>;
+    using Base::m_fit_expr;
+    using Base::m_fit_range;
+    using Base::m_quantize_fp;
+    using Base::m_scale_squared;
+    using Base::m_set_stats;
+    using Base::m_squared_error;
+    using Base::m_store;
+    using Base::m_update_code_stats;
+
+    size_t m_size;
+
+    // Both halves come from one memory_resource, the process default heap
+    // unless the constructor is given another (e.g. a per-request arena)
+    std::pmr::vector<fpT> m_fp_half;
+    std::pmr::vector<qT> m_q_half;
+
+    // Evaluates expr into this vector and requantizes the q half with
+    // parameters fitted to the result's range over both halves, as the
+    // constructor does. The first pass finds the range, the second writes.
+    template <typename E>
+    void m_assign(const E& expr) {
+        const size_t n = expr.half_size();
+        m_fit_expr(expr);
+        m_size = 2 * n + 1;
+        m_fp_half.resize(n);
+        m_q_half.resize(n);
+        m_store(expr, m_fp_half.data(), m_q_half.data());
+    }
+
+    template <typename Op, typename E>
+    void m_update(const E& expr) {
+        assert(expr.half_size() == m_fp_half.size());
+        m_assign(HybridExpr<Op, HybridTerminal<HybridVector>, E>(HybridTerminal<HybridVector>(*this), expr));
+    }
+
+public:
+
+    HybridVector(const std::vector<fpT> &vec,
+                 std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : m_fp_half(resource), m_q_half(resource) {
+        auto it_min = std::min_element(vec.begin(), vec.end());
+        auto it_max = std::max_element(vec.begin(), vec.end());
+        m_fit_range(*it_min, *it_max);
+
+        // An even-sized input is treated as padded with one 0, which always
+        // lands past the q half, so the halves are read from vec directly
+        m_size = vec.size() | 1;
 
         size_t half_size = m_size / 2;
 
@@ -78,117 +682,327 @@ public:
         m_q_half.resize(half_size);
 
         for (size_t i = 0; i < half_size; i++) {
-            m_fp_half[i] = working_vec[i];
+            m_fp_half[i] = vec[i];
         }
 
 #pragma omp simd
         for (size_t i = 0; i < half_size; i++) {
-            m_q_half[i] = m_quantize_fp(working_vec[i + half_size]);
+            m_q_half[i] = m_quantize_fp(vec[i + half_size]);
         }
+        m_update_code_stats();
     }
 
-    HybridVector& operator+=(const HybridVector& other) {
-        assert(m_fp_half.size() == other.m_fp_half.size());
-        assert(m_q_half.size() == other.m_q_half.size());
-        
-#pragma omp simd
-        for (size_t i = 0; i < m_fp_half.size(); i++) {
-            m_fp_half[i] += other.m_fp_half[i];
-            m_q_half[i] += other.m_q_half[i];
-        }
-        
+    // Also computes HybridVectorStats, e.g. HybridVector(values, hybrid_with_stats)
+    HybridVector(const std::vector<fpT>& vec, hybrid_with_stats_t,
+                 std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : HybridVector(vec, resource) {
+        m_set_stats(m_squared_error(vec.data() + m_fp_half.size()));
+    }
+
+    // Copies and moves keep the usual allocator rules: a copy uses the
+    // default resource, a move keeps the source's. This copies into resource.
+    HybridVector(const HybridVector& other, std::pmr::memory_resource* resource)
+        : Base(other),
+          m_size(other.m_size),
+          m_fp_half(other.m_fp_half, resource),
+          m_q_half(other.m_q_half, resource) {}
+
+    HybridVector(const HybridVector&) = default;
+    HybridVector(HybridVector&&) = default;
+    HybridVector& operator=(const HybridVector&) = default;
+    HybridVector& operator=(HybridVector&&) = default;
+
+    // Materialises an expression such as (a - b) * (a - b) in one pass
+    template <typename E, typename = std::enable_if_t<is_hybrid_expr<E>::value>>
+    HybridVector(const E& expr, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : m_fp_half(resource), m_q_half(resource) {
+        m_assign(expr);
+    }
+
+    template <typename E, typename = std::enable_if_t<is_hybrid_expr<E>::value>>
+    HybridVector& operator=(const E& expr) {
+        m_assign(expr);
+        return *this;
+    }
+
+    size_t half_size() const { return m_fp_half.size(); }
+    std::pmr::memory_resource* resource() const { return m_fp_half.get_allocator().resource(); }
+    const fpT* fp_half() const { return m_fp_half.data(); }
+    const qT* q_half() const { return m_q_half.data(); }
+
+    // Compound operators accept a vector or an expression (see HybridExpr);
+    // a += e is a = a + e, requantized
+    template <typename E, typename = std::enable_if_t<is_hybrid_operand<E>::value>>
+    HybridVector& operator+=(const E& other) {
+        m_update<HybridAdd>(hybrid_operand(other));
+        return *this;
+    }
+
+    template <typename E, typename = std::enable_if_t<is_hybrid_operand<E>::value>>
+    HybridVector& operator-=(const E& other) {
+        m_update<HybridSubtract>(hybrid_operand(other));
+        return *this;
+    }
+
+    template <typename E, typename = std::enable_if_t<is_hybrid_operand<E>::value>>
+    HybridVector& operator*=(const E& other) {
+        m_update<HybridMultiply>(hybrid_operand(other));
         return *this;
     }
 
-    HybridVector& operator-=(const HybridVector& other) {
+    // Evaluates a vector or expression into this vector under its current
+    // quantization parameters, in one pass: q values outside [fp_min, fp_max]
+    // saturate at the end codes. Cheaper than assignment when the range is
+    // known, e.g. accumulating into a vector with a preset range.
+    template <typename E, typename = std::enable_if_t<is_hybrid_operand<E>::value>>
+    HybridVector& assign_saturating(const E& other) {
+        m_store(hybrid_operand(other), m_fp_half.data(), m_q_half.data());
+        return *this;
+    }
+
+    fpT squared_distance_to(const HybridVector& other) const {
         assert(m_fp_half.size() == other.m_fp_half.size());
         assert(m_q_half.size() == other.m_q_half.size());
-        
-#pragma omp simd
-        for (size_t i = 0; i < m_fp_half.size(); i++) {
-            m_fp_half[i] -= other.m_fp_half[i];
-            m_q_half[i] -= other.m_q_half[i];
-        }
-        
-        return *this;
+
+        return squared_distance_to(other.m_fp_half.data(), other.m_q_half.data(), other.scale());
     }
 
-    HybridVector& operator*=(const HybridVector& other) {
+    // Distance to a row stored outside a HybridVector (e.g. in a store segment):
+    // other_fp and other_q must each hold half_size() elements.
+    fpT squared_distance_to(const fpT* other_fp, const qT* other_q, fpT other_scale) const {
+        return hybrid_squared_distance(m_fp_half.data(), m_q_half.data(), other_fp, other_q,
+                                       m_fp_half.size(), m_scale_squared(other_scale));
+    }
+
+    // Early-abandon variant: accumulates in 256-element blocks and stops as
+    // soon as the partial sum exceeds bound. Any returned value > bound only
+    // means "farther than bound", not the exact distance.
+    fpT squared_distance_to(const HybridVector& other, fpT bound) const {
         assert(m_fp_half.size() == other.m_fp_half.size());
         assert(m_q_half.size() == other.m_q_half.size());
-        
-#pragma omp simd
-        for (size_t i = 0; i < m_fp_half.size(); i++) {
-            m_fp_half[i] *= other.m_fp_half[i];
-            m_q_half[i] *= other.m_q_half[i];
-        }
-        
-        return *this;
+
+        return squared_distance_to(other.m_fp_half.data(), other.m_q_half.data(), other.scale(), bound);
     }
 
-    fpT accumulate() {
+    fpT squared_distance_to(const fpT* other_fp, const qT* other_q, fpT other_scale, fpT bound) const {
+        constexpr size_t block = 256;
+        const size_t n = m_fp_half.size();
+        const fpT scale_squared = m_scale_squared(other_scale);
+
         fpT sum = 0;
-        
-#pragma omp simd reduction(+:sum)
-        for (size_t i = 0; i < m_fp_half.size(); i++) {
-            sum += m_fp_half[i];
-            sum += m_dequantize_q(m_q_half[i]);
+        for (size_t begin = 0; begin < n; begin += block) {
+            size_t len = std::min(block, n - begin);
+            sum += hybrid_squared_distance(m_fp_half.data() + begin, m_q_half.data() + begin,
+                                           other_fp + begin, other_q + begin, len, scale_squared);
+
+            if (sum > bound) {
+                break;
+            }
         }
-        
+
         return sum;
     }
 
+};
+
+// Fixed-dimension HybridVector for a vector of Dim values. Both halves live
+// in inline std::arrays (no heap indirection), and the kernels are
+// instantiated for Dim / 2 elements, so loops have constant trip counts and
+// no tail for the usual embedding sizes (128, 384, 768, 1024, 1536).
+// Quantization and distances match the runtime-sized class for the same input.
+template <typename fpT, typename qT, size_t Dim>
+class HybridVector : public HybridVectorBase<HybridVector<fpT, qT, Dim>, fpT, qT> {
+    static_assert(Dim >= 2, "HybridVector needs at least two dimensions");
+
+public:
+    static constexpr size_t half = Dim / 2;
+
+private:
+    using Base = HybridVectorBase<HybridVector, fpT, qT>;
+    using Base::m_fit_expr;
+    using Base::m_fit_range;
+    using Base::m_quantize_fp;
+    using Base::m_scale_squared;
+    using Base::m_set_stats;
+    using Base::m_squared_error;
+    using Base::m_store;
+    using Base::m_update_code_stats;
+
+    std::array<fpT, half> m_fp_half;
+    std::array<qT, half> m_q_half;
+
+    template <typename E>
+    void m_assign(const E& expr) {
+        m_fit_expr(expr);
+        m_store(expr, m_fp_half.data(), m_q_half.data());
+    }
+
+    template <typename Op, typename E>
+    void m_update(const E& expr) {
+        m_assign(HybridExpr<Op, HybridTerminal<HybridVector>, E>(HybridTerminal<HybridVector>(*this), expr));
+    }
+
+public:
+    // vec points at Dim values; an odd Dim drops the last one, like the
+    // runtime-sized class
+    explicit HybridVector(const fpT* vec) {
+        m_fit_range(*std::min_element(vec, vec + Dim), *std::max_element(vec, vec + Dim));
+
+        std::copy(vec, vec + half, m_fp_half.begin());
+
+#pragma omp simd
+        for (size_t i = 0; i < half; i++) {
+            m_q_half[i] = m_quantize_fp(vec[i + half]);
+        }
+        m_update_code_stats();
+    }
+
+    explicit HybridVector(const std::array<fpT, Dim>& vec) : HybridVector(vec.data()) {}
+
+    explicit HybridVector(const std::vector<fpT>& vec) : HybridVector(vec.data()) {
+        assert(vec.size() == Dim);
+    }
+
+    // With HybridVectorStats, see the runtime-sized class
+    HybridVector(const fpT* vec, hybrid_with_stats_t) : HybridVector(vec) {
+        m_set_stats(m_squared_error(vec + half));
+    }
+
+    HybridVector(const std::array<fpT, Dim>& vec, hybrid_with_stats_t tag) : HybridVector(vec.data(), tag) {}
+
+    HybridVector(const std::vector<fpT>& vec, hybrid_with_stats_t tag) : HybridVector(vec.data(), tag) {
+        assert(vec.size() == Dim);
+    }
+
+    template <typename E, typename = std::enable_if_t<is_hybrid_expr<E>::value>>
+    HybridVector(const E& expr) {
+        m_assign(expr);
+    }
+
+    template <typename E, typename = std::enable_if_t<is_hybrid_expr<E>::value>>
+    HybridVector& operator=(const E& expr) {
+        m_assign(expr);
+        return *this;
+    }
+
+    static constexpr size_t half_size() { return half; }
+    const fpT* fp_half() const { return m_fp_half.data(); }
+    const qT* q_half() const { return m_q_half.data(); }
+
+    // Compound operators accept a vector or an expression, as in the
+    // runtime-sized class
+    template <typename E, typename = std::enable_if_t<is_hybrid_operand<E>::value>>
+    HybridVector& operator+=(const E& other) {
+        m_update<HybridAdd>(hybrid_operand(other));
+        return *this;
+    }
+
+    template <typename E, typename = std::enable_if_t<is_hybrid_operand<E>::value>>
+    HybridVector& operator-=(const E& other) {
+        m_update<HybridSubtract>(hybrid_operand(other));
+        return *this;
+    }
+
+    template <typename E, typename = std::enable_if_t<is_hybrid_operand<E>::value>>
+    HybridVector& operator*=(const E& other) {
+        m_update<HybridMultiply>(hybrid_operand(other));
+        return *this;
+    }
+
+    // Saturating assignment, see the runtime-sized class
+    template <typename E, typename = std::enable_if_t<is_hybrid_operand<E>::value>>
+    HybridVector& assign_saturating(const E& other) {
+        m_store(hybrid_operand(other), m_fp_half.data(), m_q_half.data());
+        return *this;
+    }
+
     fpT squared_distance_to(const HybridVector& other) const {
-        assert(m_fp_half.size() == other.m_fp_half.size());
-        assert(m_q_half.size() == other.m_q_half.size());
-        
+        return squared_distance_to(other.m_fp_half.data(), other.m_q_half.data(), other.scale());
+    }
+
+    // Distance to a row stored outside a HybridVector; other_fp and other_q
+    // must each hold half elements
+    fpT squared_distance_to(const fpT* other_fp, const qT* other_q, fpT other_scale) const {
+        return hybrid_squared_distance<fpT, qT, half>(m_fp_half.data(), m_q_half.data(), other_fp, other_q,
+                                                      half, m_scale_squared(other_scale));
+    }
+
+    // Early-abandon variant, see the runtime-sized class
+    fpT squared_distance_to(const HybridVector& other, fpT bound) const {
+        return squared_distance_to(other.m_fp_half.data(), other.m_q_half.data(), other.scale(), bound);
+    }
+
+    fpT squared_distance_to(const fpT* other_fp, const qT* other_q, fpT other_scale, fpT bound) const {
+        constexpr size_t block = 256;
+        const fpT scale_squared = m_scale_squared(other_scale);
+
         fpT sum = 0;
-        
-        // Handle special case where all values are the same (zero range)
-        if (m_fp_max == m_fp_min) {
-            // All quantized values are the same, so difference is always 0
-#pragma omp simd reduction(+:sum)
-            for (size_t i = 0; i < m_fp_half.size(); i++) {
-                fpT fp_diff = m_fp_half[i] - other.m_fp_half[i];
-                sum += fp_diff * fp_diff;
-                // q_half contribution is 0 since all values are identical
-            }
-        } else {
-            // Normal case: linearized quantized computation
-            // (dequantize(a) - dequantize(b))² = scale² * (a - b)²
-            fpT scale_squared = m_scale * other.m_scale;
-            
-#pragma omp simd reduction(+:sum)
-            for (size_t i = 0; i < m_fp_half.size(); i++) {
-                // For fp_half: compute difference and square directly
-                fpT fp_diff = m_fp_half[i] - other.m_fp_half[i];
-                sum += fp_diff * fp_diff;
-                
-                // For q_half: linearized computation (a - b)² * scale²
-                fpT q_diff = static_cast<fpT>(m_q_half[i]) - static_cast<fpT>(other.m_q_half[i]);
-                sum += q_diff * q_diff * scale_squared;
+        size_t begin = 0;
+        for (; begin + block <= half; begin += block) {
+            sum += hybrid_squared_distance<fpT, qT, block>(m_fp_half.data() + begin, m_q_half.data() + begin,
+                                                           other_fp + begin, other_q + begin, block, scale_squared);
+            if (sum > bound) {
+                return sum;
             }
         }
-        
+        if (begin < half) {
+            sum += hybrid_squared_distance<fpT, qT, half % block>(m_fp_half.data() + begin, m_q_half.data() + begin,
+                                                                  other_fp + begin, other_q + begin,
+                                                                  half % block, scale_squared);
+        }
         return sum;
     }
+};
 
-    HybridVector operator+(const HybridVector& other) const {
-        HybridVector result = *this;
-        result += other;
-        return result;
-    }
+// HybridVector fixed to the build's embedding size
+template <typename fpT, typename qT>
+using HybridVectorN = HybridVector<fpT, qT, N_DIM>;
 
-    HybridVector operator-(const HybridVector& other) const {
-        HybridVector result = *this;
-        result -= other;
-        return result;
+// Sum of many vectors times factor, requantized once at the end. Each input
+// is dequantized with its own parameters and added into fpT buffers in one
+// pass, so no intermediate vector is built. The buffers, and the result of a
+// runtime-sized V, are allocated from resource.
+template <typename V>
+V hybrid_scaled_sum(const std::vector<V>& vectors,
+                    decltype(std::declval<const V&>().scale()) factor,
+                    std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+    using fpT = decltype(std::declval<const V&>().scale());
+    assert(!vectors.empty());
+
+    const size_t n = vectors[0].half_size();
+    std::pmr::vector<fpT> fp_sum(n, 0, resource);
+    std::pmr::vector<fpT> q_sum(n, 0, resource);
+    fpT* fp_out = fp_sum.data();
+    fpT* q_out = q_sum.data();
+    for (const V& vec : vectors) {
+        assert(vec.half_size() == n);
+        const auto* fp = vec.fp_half();
+        const auto* q = vec.q_half();
+        const HybridAffine<fpT> affine = hybrid_affine(vec);
+#pragma omp simd
+        for (size_t i = 0; i < n; i++) {
+            fp_out[i] += fp[i];
+            q_out[i] += static_cast<fpT>(q[i]) * affine.scale + affine.bias;
+        }
     }
 
-    HybridVector operator*(const HybridVector& other) const {
-        HybridVector result = *this;
-        result *= other;
-        return result;
+    if constexpr (std::is_constructible<V, HybridDense<V>, std::pmr::memory_resource*>::value) {
+        return V(HybridDense<V>(fp_out, q_out, n, factor), resource);
+    } else {
+        return V(HybridDense<V>(fp_out, q_out, n, factor));
     }
+}
+
+template <typename V>
+V hybrid_sum(const std::vector<V>& vectors,
+             std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+    return hybrid_scaled_sum(vectors, 1, resource);
+}
 
-};
\ No newline at end of file
+// Elementwise mean, e.g. a k-means centroid update
+template <typename V>
+V hybrid_mean(const std::vector<V>& vectors,
+              std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+    using fpT = decltype(std::declval<const V&>().scale());
+    return hybrid_scaled_sum(vectors, static_cast<fpT>(1) / static_cast<fpT>(vectors.size()), resource);
+}
@@ -0,0 +1,125 @@
+#include "hybrid_store.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+// Pool-backed calls made from inside a job of the same pool must fall back to
+// running serially on the calling thread instead of waiting on themselves.
+// Each check compares the nested result with one computed outside the pool.
+// A job run on fewer threads than the pool has must only involve those.
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+    if (!ok) {
+        cerr << "FAILED: " << what << endl;
+        failures++;
+    }
+}
+
+static vector<HybridVector<float, uint8_t>> make_collection(size_t count, size_t dims, unsigned seed) {
+    mt19937 gen(seed);
+    uniform_real_distribution<float> dis(-1.0f, 1.0f);
+    vector<float> row(dims);
+    vector<HybridVector<float, uint8_t>> collection;
+    for (size_t i = 0; i < count; i++) {
+        for (float& x : row) {
+            x = dis(gen);
+        }
+        collection.emplace_back(row);
+    }
+    return collection;
+}
+
+static bool same_ids(const vector<Neighbor<float>>& a, const vector<Neighbor<float>>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].id != b[i].id) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void test_range_search_in_job() {
+    auto collection = make_collection(4000, 64, 1);
+    const auto& query = collection[0];
+    const float squared_radius = 8.0f;
+
+    WorkerPool pool(4);
+    auto expected = range_search(collection, query, squared_radius, IdFilter(), pool);
+    check(!expected.empty() && expected.size() < collection.size(), "range_search radius selects a strict subset");
+
+    vector<vector<Neighbor<float>>> nested(pool.num_threads());
+    pool.run([&](size_t t) {
+        nested[t] = range_search(collection, query, squared_radius, IdFilter(), pool);
+    });
+    for (const auto& result : nested) {
+        check(same_ids(result, expected), "range_search from inside pool.run matches the parallel result");
+    }
+}
+
+static void test_insert_batch_in_job() {
+    const size_t dims = 32;
+    const size_t rows_per_job = 300;
+    mt19937 gen(2);
+    uniform_real_distribution<float> dis(-1.0f, 1.0f);
+
+    WorkerPool pool(4);
+    vector<vector<vector<float>>> batches(pool.num_threads());
+    for (auto& batch : batches) {
+        for (size_t i = 0; i < rows_per_job; i++) {
+            vector<float> row(dims);
+            for (float& x : row) {
+                x = dis(gen);
+            }
+            batch.push_back(row);
+        }
+    }
+
+    HybridStore<float, uint8_t> store(dims / 2, 128, -1, 0, 1, PageSize::base);
+    vector<vector<u64>> ids(pool.num_threads());
+    pool.run([&](size_t t) {
+        ids[t] = store.insert_batch(batches[t], pool);
+    });
+
+    check(store.size() == pool.num_threads() * rows_per_job, "insert_batch from inside pool.run inserts every row");
+    for (size_t t = 0; t < pool.num_threads(); t++) {
+        for (size_t i = 0; i < rows_per_job; i++) {
+            HybridVector<float, uint8_t> row(batches[t][i]);
+            auto hits = store.search(row, 1);
+            check(!hits.empty() && hits[0].id == ids[t][i] && hits[0].distance == 0.0f,
+                  "insert_batch from inside pool.run returns each row's id");
+        }
+    }
+}
+
+static void test_partial_run() {
+    WorkerPool pool(4);
+    vector<atomic<int>> calls(pool.num_threads());
+    for (int round = 0; round < 100; round++) {
+        pool.run([&](size_t t) { calls[t]++; }, 2);
+    }
+    pool.run([&](size_t t) { calls[t]++; });
+    check(calls[0] == 101 && calls[1] == 101, "run(job, 2) calls the job on threads 0 and 1");
+    check(calls[2] == 1 && calls[3] == 1, "run(job, 2) leaves the other threads out until a full run");
+}
+
+int main() {
+    test_partial_run();
+    test_range_search_in_job();
+    test_insert_batch_in_job();
+
+    if (failures != 0) {
+        cerr << failures << " check(s) failed" << endl;
+        return EXIT_FAILURE;
+    }
+    cout << "all pool nesting checks passed" << endl;
+    return EXIT_SUCCESS;
+}
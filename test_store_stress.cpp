@@ -0,0 +1,247 @@
+#include "hybrid_store.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Concurrent insert/erase/search/compact against one HybridStore. Inserters
+// (single rows and pool batches), an eraser, pool-parallel searchers and a
+// background compactor run together; the checks cover what must hold under
+// any interleaving:
+// - a stable row that is never erased is always its own nearest neighbour,
+//   however often its segment is rewritten
+// - a row erased before a search starts never appears in its results
+// - every returned distance matches the row stored under that id
+// - a pinned snapshot keeps reading the same stable rows while compaction
+//   replaces its segments, and retired memory is freed once it is released
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+    if (!ok) {
+        cerr << "FAILED: " << what << endl;
+        failures++;
+    }
+}
+
+static void test_epoch_reclamation() {
+    EpochManager epochs;
+    atomic<int> freed{0};
+    {
+        auto guard = epochs.pin();
+        epochs.retire([&] { freed++; });
+        epochs.collect();
+        check(freed == 0, "retired object survives while a reader that could reach it is pinned");
+    }
+    epochs.collect();
+    check(freed == 1, "retired object is freed once that reader unpins");
+    check(epochs.num_retired() == 0, "nothing is left retired after collect");
+}
+
+static void test_concurrent_store() {
+    const size_t dims = 32;
+    const size_t capacity = 256;
+    const size_t num_stable = 200;
+    const size_t num_churn = 8000;
+    const size_t k = 5;
+
+    mt19937 gen(7);
+    uniform_real_distribution<float> dis(-1.0f, 1.0f);
+    vector<vector<float>> rows(num_stable + num_churn, vector<float>(dims));
+    for (auto& row : rows) {
+        for (float& x : row) {
+            x = dis(gen);
+        }
+    }
+
+    HybridStore<float, uint8_t> store(dims / 2, capacity, -1, 0, 1, PageSize::base);
+    ScanHints hints;
+    hints.threads = 4;
+    store.set_scan_hints(hints);
+    WorkerPool pool(4);
+
+    // Ids are dense per segment and never reused, so they stay below the
+    // number of rows inserted plus one segment
+    const size_t max_ids = rows.size() + capacity;
+    vector<atomic<size_t>> row_of(max_ids);
+    vector<atomic<size_t>> erased_at(max_ids);
+    for (size_t id = 0; id < max_ids; id++) {
+        row_of[id].store(SIZE_MAX, memory_order_relaxed);
+        erased_at[id].store(0, memory_order_relaxed);
+    }
+    atomic<size_t> erase_clock{0};
+
+    vector<u64> stable_ids;
+    for (size_t r = 0; r < num_stable; r++) {
+        u64 id = store.insert(HybridVector<float, uint8_t>(rows[r]));
+        stable_ids.push_back(id);
+        row_of[id].store(r);
+    }
+
+    mutex churn_mutex;
+    vector<u64> churn_ids;
+    atomic<size_t> inserters_left{2};
+    atomic<bool> stop{false};
+
+    store.start_compaction(chrono::milliseconds(1), 0.1);
+    vector<thread> threads;
+
+    // Row-at-a-time inserter over the first half of the churn rows
+    threads.emplace_back([&] {
+        for (size_t r = num_stable; r < num_stable + num_churn / 2; r++) {
+            u64 id = store.insert(HybridVector<float, uint8_t>(rows[r]));
+            row_of[id].store(r);
+            lock_guard lock(churn_mutex);
+            churn_ids.push_back(id);
+        }
+        inserters_left--;
+    });
+
+    // Batch inserter on the shared pool over the second half
+    threads.emplace_back([&] {
+        const size_t batch = 64;
+        for (size_t begin = num_stable + num_churn / 2; begin < rows.size(); begin += batch) {
+            size_t end = min(begin + batch, rows.size());
+            vector<vector<float>> chunk(rows.begin() + begin, rows.begin() + end);
+            vector<u64> ids = store.insert_batch(chunk, pool);
+            for (size_t i = 0; i < ids.size(); i++) {
+                row_of[ids[i]].store(begin + i);
+            }
+            lock_guard lock(churn_mutex);
+            churn_ids.insert(churn_ids.end(), ids.begin(), ids.end());
+        }
+        inserters_left--;
+    });
+
+    // Eraser: removes most churn rows in random order, compacting as it goes
+    threads.emplace_back([&] {
+        mt19937 pick(11);
+        size_t erased = 0;
+        for (;;) {
+            u64 id;
+            {
+                lock_guard lock(churn_mutex);
+                if (churn_ids.empty()) {
+                    if (inserters_left == 0) {
+                        break;
+                    }
+                    id = SIZE_MAX;
+                } else {
+                    size_t i = pick() % churn_ids.size();
+                    id = churn_ids[i];
+                    churn_ids[i] = churn_ids.back();
+                    churn_ids.pop_back();
+                }
+            }
+            if (id == SIZE_MAX) {
+                this_thread::yield();
+                continue;
+            }
+            // Keep every fourth churn row
+            if (pick() % 4 == 0) {
+                continue;
+            }
+            check(store.erase(id), "erase of a live row succeeds");
+            erased_at[id].store(erase_clock.fetch_add(1) + 1);
+            if (++erased % 500 == 0) {
+                store.compact(0.05);
+            }
+        }
+    });
+
+    // Searchers: pool-parallel top-k for stable rows, sharing the pool with
+    // the batch inserter and with each other
+    for (unsigned s = 0; s < 2; s++) {
+        threads.emplace_back([&, s] {
+            mt19937 pick(100 + s);
+            while (!stop) {
+                size_t r = pick() % num_stable;
+                HybridVector<float, uint8_t> query(rows[r]);
+                size_t clock_before = erase_clock.load();
+                auto hits = store.search(query, k, IdFilter(), pool);
+
+                check(!hits.empty() && hits[0].id == stable_ids[r] && hits[0].distance == 0.0f,
+                      "stable row is its own nearest neighbour");
+                for (size_t i = 0; i < hits.size(); i++) {
+                    u64 id = hits[i].id;
+                    check(i == 0 || hits[i - 1].distance <= hits[i].distance, "results are sorted");
+                    size_t erased = erased_at[id].load();
+                    check(erased == 0 || erased > clock_before, "rows erased before the search are not returned");
+                    size_t row = row_of[id].load();
+                    if (row != SIZE_MAX) {
+                        float expected = query.squared_distance_to(HybridVector<float, uint8_t>(rows[row]));
+                        check(hits[i].distance == expected, "distance matches the row stored under the id");
+                    }
+                }
+            }
+        });
+    }
+
+    // Snapshot holder: rows a pinned snapshot reaches stay in place while
+    // compaction replaces its segments, so stable rows read the same twice
+    threads.emplace_back([&] {
+        HybridVector<float, uint8_t> query(rows[0]);
+        vector<float> first(num_stable);
+        while (!stop) {
+            auto snapshot = store.snapshot();
+            auto stable_distances = [&](vector<float>& out) {
+                size_t seen = 0;
+                snapshot.scan(query, IdFilter(), [&](u64 id, float distance) {
+                    size_t row = row_of[id].load();
+                    if (row < num_stable) {
+                        out[row] = distance;
+                        seen++;
+                    }
+                });
+                return seen;
+            };
+            vector<float> second(num_stable);
+            check(stable_distances(first) == num_stable, "a snapshot sees every stable row");
+            this_thread::sleep_for(chrono::milliseconds(2));
+            check(stable_distances(second) == num_stable, "a pinned snapshot keeps every stable row");
+            check(first == second, "stable rows read the same through a pinned snapshot");
+        }
+    });
+
+    threads[0].join();
+    threads[1].join();
+    threads[2].join();
+    stop = true;
+    for (size_t t = 3; t < threads.size(); t++) {
+        threads[t].join();
+    }
+    store.stop_compaction();
+    store.compact(0.0);
+
+    size_t live = 0;
+    for (size_t id = 0; id < max_ids; id++) {
+        if (row_of[id].load() == SIZE_MAX) {
+            continue;
+        }
+        bool erased = erased_at[id].load() != 0;
+        live += !erased;
+        check(store.contains(id) == !erased, "contains() agrees with the erase log after compaction");
+    }
+    check(store.size() == live, "size() counts exactly the rows never erased");
+    check(store.compact(0.0) == 0, "compaction leaves no sealed segment with tombstones");
+
+    for (size_t r = 0; r < num_stable; r++) {
+        auto hits = store.search(HybridVector<float, uint8_t>(rows[r]), 1, IdFilter(), pool);
+        check(!hits.empty() && hits[0].id == stable_ids[r], "stable rows survive compaction");
+    }
+}
+
+int main() {
+    test_epoch_reclamation();
+    test_concurrent_store();
+
+    if (failures != 0) {
+        cerr << failures << " check(s) failed" << endl;
+        return EXIT_FAILURE;
+    }
+    cout << "all store stress checks passed" << endl;
+    return EXIT_SUCCESS;
+}